@@ -0,0 +1,90 @@
+#include "bench.h"
+#include "3_moving_to_modern_cpp.h"
+#include "Memoized.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+BENCHMARK(LazyReadThroughput)
+{
+    const size_t readsPerThread = 1'000'000;
+    const CashedPower power {2, 10};
+    // computed up front: only the read path is measured, where the unsynchronized
+    // variants have no writer to race with anymore
+    power.notMultithread1();
+    power.multithread();
+    power.lockFree();
+    const CashedPower power2 {2, 10};
+    power2.notMultithread2();
+
+    std::atomic<long long> sink {0};
+    auto readers = [&](int nThreads, auto read) {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < nThreads; t++)
+            threads.emplace_back([&] {
+                long long sum = 0;
+                for (size_t i = 0; i < readsPerThread; i++)
+                    sum += read();
+                sink += sum;
+            });
+        for (auto& t : threads)
+            t.join();
+    };
+
+    for (int nThreads : { 1, 4 })
+    {
+        const size_t reads = nThreads * readsPerThread;
+        const std::string suffix = " x" + std::to_string(nThreads) + " threads";
+        bench::measure("notMultithread1 (racy)" + suffix, 10, reads,
+            [&] { readers(nThreads, [&] { return power.notMultithread1(); }); });
+        bench::measure("notMultithread2 (racy)" + suffix, 10, reads,
+            [&] { readers(nThreads, [&] { return power2.notMultithread2(); }); });
+        bench::measure("multithread (mutex)" + suffix, 10, reads,
+            [&] { readers(nThreads, [&] { return power.multithread(); }); });
+        bench::measure("lockFree (ConcurrentLazy)" + suffix, 10, reads,
+            [&] { readers(nThreads, [&] { return power.lockFree(); }); });
+    }
+}
+
+BENCHMARK(MemoizedLookup)
+{
+    const size_t lookupsPerThread = 200'000;
+    auto power = [](int base, int exp) { return static_cast<long long>(std::pow(base, exp)); };
+
+    for (size_t shards : { 1, 16 })
+    {
+        for (int nThreads : { 1, 4 })
+        {
+            // 4096 keys over 1024 slots, the lower keys come up more often
+            Memoized<long long(int, int)> cached {power, 1024, shards};
+            auto lookups = [&] {
+                std::vector<std::thread> threads;
+                for (int t = 0; t < nThreads; t++)
+                    threads.emplace_back([&, t] {
+                        uint32_t x = 12345 + t;
+                        for (size_t i = 0; i < lookupsPerThread; i++)
+                        {
+                            x = x * 1664525 + 1013904223;
+                            uint32_t key = (x >> 8) % 4096;
+                            key = key * key / 4096; // skewed towards 0
+                            cached(2 + key % 64, static_cast<int>(key / 64));
+                        }
+                    });
+                for (auto& t : threads)
+                    t.join();
+            };
+
+            const std::string label = std::to_string(shards) + " shards x" + std::to_string(nThreads) + " threads";
+            bench::measure("Memoized " + label, 5, nThreads * lookupsPerThread, lookups);
+            auto stats = cached.stats();
+            bench::report("  stats " + label, {
+                { "hit_pct", 100 * stats.hitRate() },
+                { "evictions", static_cast<double>(stats.evictions) },
+                { "size", static_cast<double>(stats.size) },
+            });
+        }
+    }
+}
@@ -0,0 +1,287 @@
+#include "bench.h"
+#include "4_smart_pointers.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+    template<typename List>
+    void pushIterateClear(const std::string& name, size_t n)
+    {
+        bench::measure(name + " pushFront", 10, n, [n] {
+            List list;
+            for (size_t i = 0; i < n; i++)
+                list.pushFront(static_cast<int>(i));
+        });
+
+        List list;
+        for (size_t i = 0; i < n; i++)
+            list.pushFront(static_cast<int>(i));
+        std::atomic<long long> sink {0};
+        bench::measure(name + " iterate", 10, n, [&] {
+            long long sum = 0;
+            for (auto it = list.begin(); it != list.end(); ++it)
+                sum += *it;
+            sink += sum;
+        });
+
+        bench::measure(name + " push + clear", 10, n, [n] {
+            List list;
+            for (size_t i = 0; i < n; i++)
+                list.pushFront(static_cast<int>(i));
+            list.clear();
+        });
+    }
+}
+
+BENCHMARK(SmartPtrListAllocators)
+{
+    const size_t n = 1'000'000;
+    pushIterateClear<SmartPtrLinkedList<int, std::allocator<int>>>("std::allocator", n);
+    pushIterateClear<SmartPtrLinkedList<int>>("NodePoolAllocator", n);
+}
+
+namespace
+{
+    template<bool checked>
+    void traverse(const std::string& name, size_t n)
+    {
+        SmartPtrLinkedList<int, NodePoolAllocator<int>, checked> list;
+        for (size_t i = 0; i < n; i++)
+            list.pushFront(static_cast<int>(i));
+
+        std::atomic<long long> sink {0};
+        bench::measure(name + " iterate", 5, n, [&] {
+            long long sum = 0;
+            for (auto it = list.cbegin(); it != list.cend(); ++it)
+                sum += *it;
+            sink += sum;
+        });
+        bench::measure(name + " size()", 5, n, [&] { sink += list.size(); });
+        {
+            auto copy = list;
+            bench::measure(name + " operator==", 5, n, [&] { sink += list == copy; });
+        }
+    }
+}
+
+BENCHMARK(SmartPtrListTraversal)
+{
+    const size_t n = 10'000'000;
+    traverse<true>("checked (weak_ptr)", n);
+    traverse<false>("unchecked (Node*)", n);
+}
+
+namespace
+{
+    template<typename List>
+    void listIterateAndInsert(const std::string& name, size_t n, size_t inserts)
+    {
+        List list;
+        for (size_t i = 0; i < n; i++)
+            list.pushFront(static_cast<int>(i));
+
+        std::atomic<long long> sink {0};
+        bench::measure(name + " iterate", 10, n, [&] {
+            long long sum = 0;
+            for (auto it = list.cbegin(); it != list.cend(); ++it)
+                sum += *it;
+            sink += sum;
+        });
+
+        auto middle = list.begin();
+        for (size_t i = 0; i < n / 2; i++)
+            ++middle;
+        // the unrolled list may move `middle` on a split, every container continues after the new element
+        bench::measure(name + " middle inserts", 10, inserts, [&] {
+            for (size_t i = 0; i < inserts; i++)
+                middle = list.insertAfter(middle, static_cast<int>(i));
+        });
+    }
+}
+
+BENCHMARK(UnrolledListVsVector)
+{
+    const size_t n = 1'000'000;
+    const size_t inserts = 1000;
+    listIterateAndInsert<SmartPtrLinkedList<int>>("SmartPtrLinkedList", n, inserts);
+    listIterateAndInsert<UnrolledLinkedList<int>>("UnrolledLinkedList", n, inserts);
+
+    std::vector<int> vec;
+    for (size_t i = 0; i < n; i++)
+        vec.push_back(static_cast<int>(i));
+    std::atomic<long long> sink {0};
+    bench::measure("std::vector iterate", 10, n, [&] {
+        long long sum = 0;
+        for (int x : vec)
+            sum += x;
+        sink += sum;
+    });
+    auto middle = vec.begin() + n / 2;
+    bench::measure("std::vector middle inserts", 10, inserts, [&] {
+        for (size_t i = 0; i < inserts; i++)
+            middle = vec.insert(middle + 1, static_cast<int>(i));
+    });
+}
+
+BENCHMARK(SmartPtrListSnapshots)
+{
+    // the UI takes a snapshot, the producer keeps pushing
+    const size_t n = 1'000'000;
+    const size_t snapshots = 10;
+    auto run = [&]<typename List>(const std::string& name, List list) {
+        for (size_t i = 0; i < n; i++)
+            list.pushFront(static_cast<int>(i));
+        std::atomic<long long> sink {0};
+        bench::measure(name + " snapshot + pushFront", 3, snapshots, [&] {
+            for (size_t i = 0; i < snapshots; i++)
+            {
+                List snapshot = list;
+                list.pushFront(static_cast<int>(i));
+                sink += snapshot.front();
+            }
+        });
+    };
+    run("deep copy", SmartPtrLinkedList<int> {});
+    run("persistent", PersistentLinkedList<int> {});
+}
+
+BENCHMARK(SmartPtrListBulkOps)
+{
+    const size_t n = 300'000;
+    std::vector<int> values(n);
+    uint32_t x = 1;
+    for (int& v : values)
+        v = static_cast<int>((x = x * 1664525 + 1013904223) >> 8);
+
+    bench::measure("build: pushFront one by one", 10, n, [&] {
+        SmartPtrLinkedList<int> list;
+        for (auto it = values.rbegin(); it != values.rend(); ++it)
+            list.pushFront(*it);
+    });
+    bench::measure("build: range constructor", 10, n, [&] {
+        SmartPtrLinkedList<int> list (values.begin(), values.end());
+    });
+
+    std::atomic<long long> sink {0};
+    bench::measure("sort: relinking (incl. build)", 5, n, [&] {
+        SmartPtrLinkedList<int> list (values.begin(), values.end());
+        list.sort();
+    });
+    bench::measure("sort: copy out, std::sort, rebuild", 5, n, [&] {
+        SmartPtrLinkedList<int> list (values.begin(), values.end());
+        std::vector<int> copy (list.begin(), list.end());
+        std::sort(copy.begin(), copy.end());
+        list = SmartPtrLinkedList<int>(copy.begin(), copy.end());
+    });
+
+    std::vector<int> sorted = values;
+    std::sort(sorted.begin(), sorted.end());
+    bench::measure("merge two sorted lists (incl. build)", 5, 2 * n, [&] {
+        SmartPtrLinkedList<int> a (sorted.begin(), sorted.end());
+        SmartPtrLinkedList<int> b (sorted.begin(), sorted.end());
+        a.merge(b);
+        sink += a.size();
+    });
+}
+
+namespace
+{
+    // the layout MyCollection had before FastPimpl: the implementation on the heap
+    struct HeapPimplCollection
+    {
+        std::unique_ptr<std::vector<int>> impl;
+
+        HeapPimplCollection() : impl {std::make_unique<std::vector<int>>()} {}
+        HeapPimplCollection(std::initializer_list<int> l) : impl {std::make_unique<std::vector<int>>(l)} {}
+        HeapPimplCollection(const HeapPimplCollection& other) : impl {std::make_unique<std::vector<int>>(*other.impl)} {}
+        int size() const noexcept { return static_cast<int>(impl->size()); }
+    };
+
+    template<typename Collection>
+    void constructAndCopy(const std::string& name)
+    {
+        std::atomic<long long> sink {0};
+        size_t before = bench::allocations();
+        {
+            Collection empty;
+            Collection emptyCopy = empty;
+            size_t emptyAllocations = bench::allocations() - before;
+            Collection filled {1, 2, 3};
+            Collection filledCopy = filled;
+            bench::report(name + " allocations", {
+                { "empty+copy", static_cast<double>(emptyAllocations) },
+                { "filled+copy", static_cast<double>(bench::allocations() - before - emptyAllocations) },
+            });
+            sink += emptyCopy.size() + filledCopy.size();
+        }
+
+        const size_t n = 100'000;
+        bench::measure(name + " construct + copy, empty", 10, n, [&] {
+            for (size_t i = 0; i < n; i++)
+            {
+                Collection c;
+                Collection copy = c;
+                sink += copy.size();
+            }
+        });
+        bench::measure(name + " construct + copy, 3 ints", 10, n, [&] {
+            for (size_t i = 0; i < n; i++)
+            {
+                Collection c {1, 2, 3};
+                Collection copy = c;
+                sink += copy.size();
+            }
+        });
+    }
+}
+
+BENCHMARK(PimplConstruction)
+{
+    constructAndCopy<HeapPimplCollection>("unique_ptr pimpl");
+    constructAndCopy<MyCollection>("FastPimpl");
+}
+
+BENCHMARK(MyCollectionRemove)
+{
+    const size_t n = 1'000'000;
+    const size_t k = 100'000;
+    std::vector<int> values(n);
+    for (size_t i = 0; i < n; i++)
+        values[i] = static_cast<int>(i * 2654435761u); // distinct, scattered
+    std::vector<int> removed;
+    for (size_t i = 0; i < k; i++)
+        removed.push_back(values[i * (n / k)]);
+
+    std::atomic<long long> sink {0};
+    for (auto [name, mode] : { std::pair {"unordered", MyCollection::Mode::Unordered},
+                               std::pair {"indexed", MyCollection::Mode::Indexed} })
+    {
+        MyCollection numbers {mode};
+        numbers.add(values);
+        const std::string label = name;
+
+        // one by one without an index is O(n) per value, 100k of them would take minutes
+        const size_t oneByOne = mode == MyCollection::Mode::Indexed ? k : 100;
+        bench::measure(label + ": remove one by one (incl. copy)", 5, oneByOne, [&] {
+            MyCollection copy = numbers;
+            for (size_t i = 0; i < oneByOne; i++)
+                copy.remove(removed[i]);
+            sink += copy.size();
+        });
+        bench::measure(label + ": remove 100k as a batch (incl. copy)", 5, k, [&] {
+            MyCollection copy = numbers;
+            copy.remove(removed);
+            sink += copy.size();
+        });
+        bench::measure(label + ": copy only", 5, k, [&] {
+            MyCollection copy = numbers;
+            sink += copy.size();
+        });
+    }
+}
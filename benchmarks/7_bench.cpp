@@ -0,0 +1,425 @@
+#include "bench.h"
+#include "7_the_concurrency_api.h"
+#include "ThreadPool.h"
+#include "StartGate.h"
+#include "ShardedCounter.h"
+#include "ConcurrentQueue.h"
+#include "AdaptiveAsync.h"
+#include "LockFreeLinkedList.h"
+#include "future_coro.h"
+#include "Task.h"
+#include "SyncWaitTask.h"
+#include "util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+
+namespace
+{
+    // the helpers in 7_the_concurrency_api.h keep every thread alive until
+    // the start signal, 100k threads at once would exhaust the process limits
+    constexpr int MAX_THREADS_PER_CALL = 1000;
+
+    ThreadPool& sharedPool()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    // baseline for QueueThroughput, same interface as BlockingQueue
+    class MutexQueue
+    {
+        std::mutex mutex;
+        std::condition_variable notFull, notEmpty;
+        std::deque<int> values;
+        size_t limit;
+        bool closed = false;
+
+    public:
+        explicit MutexQueue(size_t capacity) : limit {capacity} {}
+
+        bool push(int value)
+        {
+            std::unique_lock lock {mutex};
+            notFull.wait(lock, [this] { return values.size() < limit || closed; });
+            if (closed) return false;
+            values.push_back(value);
+            notEmpty.notify_one();
+            return true;
+        }
+
+        std::optional<int> pop()
+        {
+            std::unique_lock lock {mutex};
+            notEmpty.wait(lock, [this] { return !values.empty() || closed; });
+            if (values.empty()) return std::nullopt;
+            int value = values.front();
+            values.pop_front();
+            notFull.notify_one();
+            return value;
+        }
+
+        void close()
+        {
+            std::lock_guard lock {mutex};
+            closed = true;
+            notFull.notify_all();
+            notEmpty.notify_all();
+        }
+    };
+
+    /** @brief Moves `perProducer` values from every producer to the consumers */
+    template<typename Queue>
+    void transfer(int producers, int consumers, int perProducer)
+    {
+        Queue queue {1024};
+        std::vector<std::thread> threads;
+        for (int c = 0; c < consumers; c++)
+            threads.emplace_back([&queue] { while (queue.pop()) {} });
+        std::vector<std::thread> producing;
+        for (int p = 0; p < producers; p++)
+            producing.emplace_back([&queue, perProducer] {
+                for (int i = 0; i < perProducer; i++)
+                    queue.push(int{i});
+            });
+        for (auto& t : producing)
+            t.join();
+        queue.close();
+        for (auto& t : threads)
+            t.join();
+    }
+}
+
+BENCHMARK(TaskLaunchLatency)
+{
+    const size_t repetitions = 1000;
+    std::atomic<int> counter {0};
+    auto tiny = [&counter] { counter.fetch_add(1, std::memory_order_relaxed); };
+
+    // launch one tiny task and wait for it: the round trip a single launch costs
+    bench::measure("std::thread", repetitions, 1, [&] {
+        std::thread t {tiny};
+        t.join();
+    });
+    bench::measure("std::async(launch::async)", repetitions, 1, [&] {
+        std::async(std::launch::async, tiny).get();
+    });
+    bench::measure("ThreadPool::submit", repetitions, 1, [&] {
+        sharedPool().submit(tiny).get();
+    });
+}
+
+BENCHMARK(TinyTaskThroughput)
+{
+    ThreadPool& pool = sharedPool();
+    std::atomic<int> counter {0};
+    auto tiny = [&counter] { counter.fetch_add(1, std::memory_order_relaxed); };
+
+    for (int n : { 10, 1'000, 100'000 })
+    {
+        const size_t repetitions = n >= 100'000 ? 5 : 20;
+        auto label = [n](const char* what) { return std::string{what} + " n=" + std::to_string(n); };
+
+        auto withStart = [&](auto use) {
+            return [&, use] {
+                std::promise<void> p;
+                auto startFuture = p.get_future().share();
+                use(std::move(p), [&tiny, startFuture] { startFuture.wait(); tiny(); });
+            };
+        };
+
+        if (n <= MAX_THREADS_PER_CALL)
+        {
+            bench::measure(label("useThreads"), repetitions, n, withStart([n](auto&& p, auto task) {
+                useThreads(n, std::move(p), task);
+            }));
+            bench::measure(label("useAsync"), repetitions, n, withStart([n](auto&& p, auto task) {
+                useAsync(n, std::move(p), task);
+            }));
+        }
+        else
+        {
+            std::printf("%-44s skipped, %d threads at once\n", label("useThreads/useAsync").c_str(), n);
+        }
+
+        bench::measure(label("usePool"), repetitions, n, withStart([&pool, n](auto&& p, auto task) {
+            usePool(pool, n, std::move(p), task);
+        }));
+        bench::measure(label("ThreadPool::submit per task"), repetitions, n, [&] {
+            std::vector<std::future<void>> futures;
+            futures.reserve(n);
+            for (int i = 0; i < n; i++)
+                futures.push_back(pool.submit(tiny));
+            for (auto& f : futures)
+                f.get();
+        });
+        bench::measure(label("ThreadPool::bulk_submit"), repetitions, n, [&] {
+            pool.bulk_submit(n, [&tiny](size_t) { tiny(); }).get();
+        });
+    }
+}
+
+BENCHMARK(StartSkew)
+{
+    using clock = StartGate::clock;
+    struct alignas(CACHE_LINE_SIZE) Stamp
+    {
+        clock::time_point departed;
+    };
+    const size_t repetitions = 20;
+
+    const int maxThreads = std::max(4u, 2 * std::thread::hardware_concurrency());
+    for (int n = 2; n <= maxThreads; n *= 2)
+    {
+        // the start signal used by multithreadAtomicIncrement and friends
+        bench::sample("shared_future skew threads=" + std::to_string(n), repetitions, [n] {
+            std::vector<Stamp> stamps(n);
+            std::atomic<int> next {0};
+            std::promise<void> p;
+            auto startFuture = p.get_future().share();
+            useThreads(n, std::move(p), [&stamps, &next, startFuture] {
+                int slot = next++;
+                startFuture.wait();
+                stamps[slot].departed = clock::now();
+            });
+            auto [first, last] = std::minmax_element(stamps.begin(), stamps.end(),
+                [](const Stamp& a, const Stamp& b) { return a.departed < b.departed; });
+            return last->departed - first->departed;
+        });
+        bench::sample("StartGate skew threads=" + std::to_string(n), repetitions, [n] {
+            StartGate gate {static_cast<size_t>(n)};
+            useThreads(n, gate, [] {});
+            return gate.skew();
+        });
+    }
+}
+
+namespace
+{
+    /**
+     * @returns ns per increment, from the gate opening until the last thread is done,
+     *          thread creation and wake-up are not measured
+     */
+    template<typename Increment>
+    double contendedIncrements(int nThreads, int perThread, Increment increment)
+    {
+        StartGate gate {static_cast<size_t>(nThreads)};
+        std::atomic<StartGate::clock::rep> lastFinish {0};
+        useThreads(nThreads, gate, [&] {
+            for (int i = 0; i < perThread; i++)
+                increment();
+            auto now = StartGate::clock::now().time_since_epoch().count();
+            auto last = lastFinish.load();
+            while (last < now && !lastFinish.compare_exchange_weak(last, now)) {}
+        });
+        auto elapsed = StartGate::clock::duration{lastFinish.load()} - gate.openedAt().time_since_epoch();
+        return std::chrono::duration<double, std::nano>(elapsed).count() / (double(nThreads) * perThread);
+    }
+}
+
+BENCHMARK(ContendedCounter)
+{
+    const int perThread = 200'000;
+    for (int n = 1; n <= 128; n *= 2)
+    {
+        std::atomic<long long> atomic {0};
+        double atomicNs = contendedIncrements(n, perThread, [&atomic] {
+            atomic.fetch_add(1, std::memory_order_relaxed);
+        });
+
+        ShardedCounter<> sharded;
+        double shardedNs = contendedIncrements(n, perThread, [&sharded] { sharded.add(1); });
+
+        if (atomic.load() != sharded.read())
+            std::printf("counter mismatch: %lld != %lld\n", atomic.load(), sharded.read());
+        bench::report("threads=" + std::to_string(n), {
+            { "std::atomic ns/add", atomicNs },
+            { "ShardedCounter ns/add", shardedNs },
+        });
+    }
+}
+
+// asyncMeasureTime as a distribution: how long after the launch call the task starts,
+// and what a whole launch + run + join costs, for every way the examples launch work
+BENCHMARK(LaunchPolicies)
+{
+    using clock = bench::clock;
+    const size_t iterations = 2000;
+
+    bench::sample("start delay std::async(launch::async)", iterations, [] {
+        auto launched = clock::now();
+        return std::async(std::launch::async, [] { return clock::now(); }).get() - launched;
+    });
+    bench::sample("start delay std::async(launch::deferred)", iterations, [] {
+        auto launched = clock::now();
+        return std::async(std::launch::deferred, [] { return clock::now(); }).get() - launched;
+    });
+    bench::sample("start delay std::thread", iterations, [] {
+        clock::time_point started;
+        auto launched = clock::now();
+        std::thread t {[&started] { started = clock::now(); }};
+        t.join();
+        return started - launched;
+    });
+    bench::sample("start delay std::future coroutine", iterations, [] {
+        auto coro = []() -> std::future<clock::time_point> { co_return clock::now(); };
+        auto launched = clock::now();
+        return coro().get() - launched;
+    });
+    bench::sample("resume delay future_coro awaiter", iterations, [] {
+        // the awaiter resumes the coroutine from a fresh thread once the future is ready
+        auto coro = []() -> std::future<clock::duration> {
+            auto ready = co_await std::async(std::launch::async, [] { return clock::now(); });
+            co_return clock::now() - ready;
+        };
+        return coro().get();
+    });
+    bench::sample("start delay Task + startTask", iterations, [] {
+        auto task = []() -> Task<clock::time_point> { co_return clock::now(); };
+        auto t = task();
+        auto launched = clock::now();
+        return startTask(std::move(t)).result() - launched;
+    });
+
+    auto noop = [] { return 1; };
+    bench::measure("round trip std::async(launch::async)", iterations, 1, [&] {
+        std::async(std::launch::async, noop).get();
+    });
+    bench::measure("round trip std::async(launch::deferred)", iterations, 1, [&] {
+        std::async(std::launch::deferred, noop).get();
+    });
+    bench::measure("round trip std::thread", iterations, 1, [&] {
+        std::thread t {noop};
+        t.join();
+    });
+    bench::measure("round trip future_coro awaiter", iterations, 1, [] {
+        auto coro = []() -> std::future<int> {
+            co_return co_await std::async(std::launch::async, [] { return 1; });
+        };
+        coro().get();
+    });
+    bench::measure("round trip Task + startTask", iterations, 1, [] {
+        auto task = []() -> Task<int> { co_return 1; };
+        startTask(task()).result();
+    });
+}
+
+BENCHMARK(QueueThroughput)
+{
+    const int perProducer = 100'000;
+    for (int n : { 1, 2, 4 })
+    {
+        const size_t items = size_t(n) * perProducer;
+        const std::string shape = " " + std::to_string(n) + "p" + std::to_string(n) + "c";
+        bench::measure("mutex + deque" + shape, 10, items,
+            [&] { transfer<MutexQueue>(n, n, perProducer); });
+        bench::measure("BlockingQueue<MpmcQueue>" + shape, 10, items,
+            [&] { transfer<BlockingQueue<MpmcQueue<int>>>(n, n, perProducer); });
+        if (n == 1)
+            bench::measure("BlockingQueue<SpscQueue>" + shape, 10, items,
+                [&] { transfer<BlockingQueue<SpscQueue<int>>>(1, 1, perProducer); });
+    }
+}
+
+BENCHMARK(AdaptiveLaunch)
+{
+    const size_t iterations = 2000;
+    ThreadPool& pool = sharedPool();
+
+    // findMatchingFile on a short list, and a task worth a hand-off
+    const std::vector<std::string> names { "a.txt", "b.h", "c.cpp", "d.md", "e.json", "f.cmake" };
+    auto tiny = [&names] {
+        return std::find_if(names.begin(), names.end(), [](auto& n) { return n.ends_with(".md"); }) - names.begin();
+    };
+    auto slow = [] {
+        auto until = bench::clock::now() + std::chrono::microseconds(200);
+        while (bench::clock::now() < until) {}
+        return 1;
+    };
+
+    auto compare = [&](const char* name, auto task, size_t repetitions) {
+        const std::string suffix = std::string(" ") + name;
+        bench::measure("std::async(launch::async)" + suffix, repetitions, 1, [&] {
+            std::async(std::launch::async, task).get();
+        });
+        bench::measure("ThreadPool::submit" + suffix, repetitions, 1, [&] {
+            pool.submit(task).get();
+        });
+        bench::measure("adaptive_async" + suffix, repetitions, 1, [&] {
+            adaptive_async(pool, task).get();
+        });
+        bench::report("adaptive_async" + suffix + " chose", {
+            { toString(adaptiveCallSite<decltype(task)>().lastLaunch()), 1 },
+        });
+    };
+    compare("tiny", tiny, iterations);
+    compare("200us", slow, iterations / 10);
+}
+
+namespace
+{
+    /** @brief The global-lock baseline for LockFreeLinkedList */
+    class MutexSet
+    {
+        std::mutex mutex;
+        std::set<int> set;
+    public:
+        bool insert(int v) { std::lock_guard lock {mutex}; return set.insert(v).second; }
+        bool erase(int v) { std::lock_guard lock {mutex}; return set.erase(v) > 0; }
+        bool contains(int v) { std::lock_guard lock {mutex}; return set.contains(v); }
+    };
+
+    // 80% lookups, 10% inserts, 10% erases on a set of about half the keys
+    template<typename Set>
+    void mixedSetOps(Set& set, int nThreads, int perThread, int keys)
+    {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < nThreads; t++)
+            threads.emplace_back([&, t] {
+                uint32_t x = 12345 + t;
+                for (int i = 0; i < perThread; i++)
+                {
+                    x = x * 1664525 + 1013904223;
+                    int key = (x >> 8) % keys;
+                    uint32_t op = (x >> 24) % 10;
+                    if (op == 0) set.insert(key);
+                    else if (op == 1) set.erase(key);
+                    else set.contains(key);
+                }
+            });
+        for (auto& t : threads)
+            t.join();
+    }
+}
+
+BENCHMARK(LockFreeListScaling)
+{
+    const int keys = 512, perThread = 100'000;
+    const int maxThreads = std::max(8u, std::thread::hardware_concurrency());
+    for (int n = 1; n <= maxThreads; n *= 2)
+    {
+        const size_t ops = size_t(n) * perThread;
+        const std::string suffix = " x" + std::to_string(n) + " threads";
+
+        MutexSet locked;
+        LockFreeLinkedList<int> lockFree;
+        for (int key = 0; key < keys; key += 2)
+        {
+            locked.insert(key);
+            lockFree.insert(key);
+        }
+        bench::measure("std::set + mutex" + suffix, 5, ops, [&] { mixedSetOps(locked, n, perThread, keys); });
+        bench::measure("LockFreeLinkedList" + suffix, 5, ops, [&] { mixedSetOps(lockFree, n, perThread, keys); });
+    }
+}
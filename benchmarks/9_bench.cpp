@@ -0,0 +1,130 @@
+#include "bench.h"
+#include "util.h"
+#include "FtpExampleSync.h"
+#include "FtpLatency.h"
+#include "LatencyHistogram.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace
+{
+    void reportLatency(const char* label, const LatencyHistogram& h)
+    {
+        auto s = h.summary();
+        auto us = [](LatencyHistogram::duration d) { return std::chrono::duration<double, std::micro>(d).count(); };
+        bench::report(label, {
+            { "calls", static_cast<double>(s.count) },
+            { "p50_us", us(s.p50) },
+            { "p99_us", us(s.p99) },
+            { "p999_us", us(s.p999) },
+            { "max_us", us(s.max) },
+        });
+    }
+}
+
+BENCHMARK(LatencyRecorderOverhead)
+{
+    const size_t n = 1'000'000;
+    LatencyRecorder recorder;
+    bench::measure("LatencyRecorder::record", 5, n, [&] {
+        for (size_t i = 0; i < n; i++)
+            recorder.record(std::chrono::nanoseconds(i & 0xffff));
+    });
+    bench::measure("LatencyRecorder::time (2 clock reads)", 5, n, [&] {
+        for (size_t i = 0; i < n; i++)
+            auto timer = recorder.time();
+    });
+}
+
+BENCHMARK(FtpLatencyUnderLoad)
+{
+    const std::string path = getProjectPath() + "/src/include";
+    std::vector<std::string> headers;
+    for (const auto& e : std::filesystem::directory_iterator{path})
+        if (e.is_regular_file()) headers.push_back(e.path().filename().string());
+
+    // every call downloads a different header, all workers busy at once
+    const size_t calls = 20 * headers.size();
+    kw::enableFtpLatency();
+    ThreadPool pool;
+    pool.bulk_submit(calls, [&](size_t i) {
+        kw::FTPExampleSync ftp;
+        const std::string& name = headers[i % headers.size()];
+        (void)ftp.tryDownloadFirstMatch(path,
+            [&name](std::string_view f) { return f.ends_with("/" + name); }, [](int) {});
+    }).get();
+
+    auto& latency = kw::ftpLatency();
+    reportLatency("LIST", latency.list.snapshot());
+    reportLatency("MATCH", latency.match.snapshot());
+    reportLatency("DOWNLOAD", latency.download.snapshot());
+    kw::enableFtpLatency(false);
+}
+
+BENCHMARK(WorkerPlacement)
+{
+    const std::string path = getProjectPath() + "/src/include";
+    std::vector<std::string> headers;
+    for (const auto& e : std::filesystem::directory_iterator{path})
+        if (e.is_regular_file()) headers.push_back(e.path().filename().string());
+
+    const size_t bufferSize = 256 * 1024;
+    for (auto placement : { WorkerPlacement::Unpinned, WorkerPlacement::Core, WorkerPlacement::Node })
+    {
+        ThreadPool pool {{ .placement = placement, .workerBufferSize = bufferSize }};
+        const std::string name = toString(placement);
+        bench::report("placement " + name, {
+            { "workers", static_cast<double>(pool.threadCount()) },
+            { "pinned", static_cast<double>(pool.pinnedCount()) },
+            { "nodes", static_cast<double>(pool.nodeCount()) },
+        });
+
+        // memory bound: every worker copies within its own buffer
+        const size_t copies = 64 * pool.threadCount();
+        bench::measure(name + ": buffer copies", 10, copies, [&] {
+            pool.bulk_submit(copies, [](size_t) {
+                auto buf = ThreadPool::workerBuffer();
+                std::memmove(buf.data(), buf.data() + buf.size() / 2, buf.size() / 2);
+            }).get();
+        });
+
+        // the download workers, copying through the worker buffers
+        const size_t downloads = 4 * headers.size();
+        bench::measure(name + ": downloads", 5, downloads, [&] {
+            pool.bulk_submit(downloads, [&](size_t i) {
+                kw::FTPExampleSync ftp;
+                const std::string& header = headers[i % headers.size()];
+                (void)ftp.tryDownloadFirstMatch(path,
+                    [&header](std::string_view f) { return f.ends_with("/" + header); }, [](int) {});
+            }).get();
+        });
+    }
+}
+
+BENCHMARK(FtpCachedDownload)
+{
+    const std::string path = getProjectPath() + "/src/include";
+    auto isTask = [](std::string_view f) { return f.ends_with("/Task.h"); };
+    kw::FTPExampleSync ftp;
+
+    auto allocationsPerCall = [](auto&& call) {
+        call(); // warmup
+        size_t before = bench::allocations();
+        call();
+        return static_cast<double>(bench::allocations() - before);
+    };
+    auto plain = [&] { (void)ftp.tryDownloadFirstMatch(path, isTask, [](int) {}); };
+    auto cached = [&] { (void)ftp.tryDownloadFirstMatchCached(path, isTask, [](int) {}); };
+    bench::report("allocations per call", {
+        { "tryDownloadFirstMatch", allocationsPerCall(plain) },
+        { "tryDownloadFirstMatchCached", allocationsPerCall(cached) },
+    });
+
+    bench::measure("tryDownloadFirstMatch", 50, 1, plain);
+    bench::measure("tryDownloadFirstMatchCached", 50, 1, cached);
+}
@@ -0,0 +1,242 @@
+#pragma once
+#include "CpuAffinity.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef> // size_t
+#include <cstdio>
+#include <initializer_list>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Small statistical benchmark harness.
+ *
+ * Benchmarks register themselves with BENCHMARK(name) and report through
+ * bench::measure (times a callable), bench::sample (the callable returns
+ * its own sample, e.g. a start delay) or bench::report (custom values).
+ * Every result is printed and collected for the JSON results file
+ * written by main(), see main.cpp for the command line.
+ */
+namespace bench
+{
+    using clock = std::chrono::steady_clock;
+
+    struct Benchmark
+    {
+        const char* name;
+        void (*run)();
+    };
+
+    inline std::vector<Benchmark>& registry()
+    {
+        static std::vector<Benchmark> benchmarks;
+        return benchmarks;
+    }
+
+    struct Registrar
+    {
+        Registrar(const char* name, void (*run)()) { registry().push_back({ name, run }); }
+    };
+
+    struct Options
+    {
+        size_t iterations = 0;          // 0: the count each benchmark asks for
+        size_t warmup = size_t(-1);     // -1: a tenth of the iterations
+        int pinCpu = -1;                // -1: not pinned
+        std::string jsonPath = "bench_results.json";
+    };
+
+    inline Options& options()
+    {
+        static Options o;
+        return o;
+    }
+
+    struct Stats
+    {
+        size_t samples = 0;
+        double mean = 0, stddev = 0, min = 0, p50 = 0, p90 = 0, p99 = 0, max = 0;
+    };
+
+    struct Result
+    {
+        std::string benchmark;
+        std::string label;
+        size_t items = 0;   // 0 for custom values
+        Stats stats;
+        std::vector<std::pair<std::string, double>> values;
+    };
+
+    inline std::vector<Result>& results()
+    {
+        static std::vector<Result> all;
+        return all;
+    }
+
+    inline std::string& currentBenchmark()
+    {
+        static std::string name;
+        return name;
+    }
+
+    inline Stats summarize(std::vector<double> samples)
+    {
+        Stats s;
+        s.samples = samples.size();
+        if (samples.empty()) return s;
+
+        std::sort(samples.begin(), samples.end());
+        auto rank = [&](double p) { return samples[static_cast<size_t>(p * (samples.size() - 1) + 0.5)]; };
+        double sum = 0;
+        for (double x : samples) sum += x;
+        s.mean = sum / samples.size();
+        double squares = 0;
+        for (double x : samples) squares += (x - s.mean) * (x - s.mean);
+        s.stddev = samples.size() > 1 ? std::sqrt(squares / (samples.size() - 1)) : 0;
+        s.min = samples.front();
+        s.p50 = rank(0.50);
+        s.p90 = rank(0.90);
+        s.p99 = rank(0.99);
+        s.max = samples.back();
+        return s;
+    }
+
+    inline void print(const Result& r)
+    {
+        const Stats& s = r.stats;
+        std::printf("%-44s mean %11.0f ns  sd %9.0f  p50 %11.0f  p99 %11.0f  max %11.0f",
+                    r.label.c_str(), s.mean, s.stddev, s.p50, s.p99, s.max);
+        if (r.items > 1) std::printf("  %8.1f ns/item", s.p50 / r.items);
+        std::printf("\n");
+    }
+
+    /**
+     * @brief Calls `next` for the warmup and the measured iterations
+     * @param next Returns one sample in ns
+     */
+    template<typename F>
+    void collect(const std::string& label, size_t iterations, size_t items, F&& next)
+    {
+        const Options& o = options();
+        if (o.iterations) iterations = o.iterations;
+        size_t warmup = o.warmup != size_t(-1) ? o.warmup : std::max<size_t>(iterations / 10, 1);
+
+        for (size_t i = 0; i < warmup; i++)
+            next();
+
+        std::vector<double> samples;
+        samples.reserve(iterations);
+        for (size_t i = 0; i < iterations; i++)
+            samples.push_back(next());
+
+        Result r { currentBenchmark(), label, std::max<size_t>(items, 1), summarize(std::move(samples)), {} };
+        print(r);
+        results().push_back(std::move(r));
+    }
+
+    /**
+     * @brief Times `fn` over the iterations, after a warmup
+     * @param items Units of work done by one call of `fn`, for the per-item time
+     */
+    template<typename F>
+    void measure(const std::string& label, size_t iterations, size_t items, F&& fn)
+    {
+        collect(label, iterations, items, [&fn] {
+            auto start = clock::now();
+            fn();
+            return std::chrono::duration<double, std::nano>(clock::now() - start).count();
+        });
+    }
+
+    /** @brief Same as measure(), but `fn` returns the sample itself as a clock duration */
+    template<typename F>
+    void sample(const std::string& label, size_t iterations, F&& fn)
+    {
+        collect(label, iterations, 1, [&fn] {
+            return std::chrono::duration<double, std::nano>(fn()).count();
+        });
+    }
+
+    /** @returns How many times the calling thread called operator new so far, counted in main.cpp */
+    size_t allocations() noexcept;
+
+    /** @brief Reports values computed by the benchmark itself, e.g. skew or ns per add */
+    inline void report(const std::string& label, std::initializer_list<std::pair<const char*, double>> values)
+    {
+        Result r { currentBenchmark(), label, 0, {}, {} };
+        std::printf("%-44s", label.c_str());
+        for (auto& [name, value] : values)
+        {
+            std::printf(" %s %10.1f", name, value);
+            r.values.emplace_back(name, value);
+        }
+        std::printf("\n");
+        results().push_back(std::move(r));
+    }
+
+    inline std::string jsonString(const std::string& s)
+    {
+        std::string out = "\"";
+        for (char c : s)
+        {
+            if (c == '"' || c == '\\') out += '\\';
+            out += c;
+        }
+        return out + '"';
+    }
+
+    /** @brief Writes the collected results, one JSON object per benchmark result */
+    inline bool writeJson(const std::string& path)
+    {
+        std::FILE* f = std::fopen(path.c_str(), "w");
+        if (!f) return false;
+
+#if defined(_MSC_VER)
+        const std::string compiler = "msvc " + std::to_string(_MSC_VER);
+#elif defined(__clang__)
+        const std::string compiler = "clang " __clang_version__;
+#elif defined(__GNUC__)
+        const std::string compiler = "gcc " __VERSION__;
+#else
+        const std::string compiler = "unknown";
+#endif
+#if defined(NDEBUG)
+        const bool optimized = true;
+#else
+        const bool optimized = false;
+#endif
+        std::fprintf(f, "{\n  \"context\": {\"compiler\": %s, \"ndebug\": %s, \"hardware_threads\": %u, "
+                        "\"numa_nodes\": %zu, \"pinned_cpu\": %d},\n",
+                     jsonString(compiler).c_str(), optimized ? "true" : "false",
+                     std::thread::hardware_concurrency(), numaNodes().size(), options().pinCpu);
+        std::fprintf(f, "  \"results\": [");
+        const auto& all = results();
+        for (size_t i = 0; i < all.size(); i++)
+        {
+            const Result& r = all[i];
+            std::fprintf(f, "%s\n    {\"benchmark\": %s, \"label\": %s", i ? "," : "",
+                         jsonString(r.benchmark).c_str(), jsonString(r.label).c_str());
+            if (r.stats.samples)
+            {
+                const Stats& s = r.stats;
+                std::fprintf(f, ", \"items\": %zu, \"samples\": %zu, \"mean_ns\": %.1f, \"stddev_ns\": %.1f, "
+                                "\"min_ns\": %.1f, \"p50_ns\": %.1f, \"p90_ns\": %.1f, \"p99_ns\": %.1f, \"max_ns\": %.1f",
+                             r.items, s.samples, s.mean, s.stddev, s.min, s.p50, s.p90, s.p99, s.max);
+            }
+            for (auto& [name, value] : r.values)
+                std::fprintf(f, ", %s: %.3f", jsonString(name).c_str(), value);
+            std::fprintf(f, "}");
+        }
+        std::fprintf(f, "\n  ]\n}\n");
+        return std::fclose(f) == 0;
+    }
+}
+
+#define BENCHMARK(name) \
+    static void name(); \
+    static const bench::Registrar name##Registrar { #name, name }; \
+    static void name()
@@ -0,0 +1,80 @@
+#include "bench.h"
+#include "CpuAffinity.h"
+
+#include <cstddef> // size_t
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <string_view>
+
+// every allocation of the benchmarks comes through here, for bench::allocations()
+namespace
+{
+    thread_local size_t allocationCount = 0;
+}
+
+size_t bench::allocations() noexcept
+{
+    return allocationCount;
+}
+
+void* operator new(size_t size)
+{
+    allocationCount++;
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+// usage: modern_cpp_bench [--iterations=N] [--warmup=N] [--pin=CPU] [--json=PATH] [name filter]
+int main(int argc, char** argv)
+{
+    bench::Options& o = bench::options();
+    std::string_view filter;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg = argv[i];
+        auto value = [&](std::string_view option) {
+            return arg.starts_with(option) ? arg.substr(option.size()).data() : nullptr;
+        };
+        if (auto v = value("--iterations="))  o.iterations = std::strtoull(v, nullptr, 10);
+        else if (auto v = value("--warmup=")) o.warmup = std::strtoull(v, nullptr, 10);
+        else if (auto v = value("--pin="))    o.pinCpu = std::atoi(v);
+        else if (auto v = value("--json="))   o.jsonPath = v;
+        else filter = arg;
+    }
+
+    // the measuring thread stays on one core, thread migrations add noise
+    if (o.pinCpu >= 0 && !pinCurrentThreadToCpu(static_cast<unsigned>(o.pinCpu)))
+    {
+        std::printf("cannot pin to cpu %d, running unpinned\n", o.pinCpu);
+        o.pinCpu = -1;
+    }
+
+    for (const auto& b : bench::registry())
+    {
+        if (std::string_view{b.name}.find(filter) == std::string_view::npos)
+            continue;
+        std::printf("== %s\n", b.name);
+        bench::currentBenchmark() = b.name;
+        b.run();
+    }
+
+    if (!o.jsonPath.empty() && !bench::writeJson(o.jsonPath))
+    {
+        std::printf("cannot write %s\n", o.jsonPath.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -1,50 +1,216 @@
 #include "4_smart_pointers.h"
 
+#include <algorithm>
+#include <bit>
+#include <cstdint>
 #include <iostream>
 #include <vector>
-#include <memory>
 #include <initializer_list>
+#include <utility>
+
+namespace
+{
+    /**
+     * @brief Counts ints in an open-addressing hash table with linear probing.
+     *        Erasing shifts the rest of the probe run back, so there are no
+     *        tombstones and lookups stay short after many removes.
+     */
+    class CountingHashIndex
+    {
+        struct Slot
+        {
+            int value;
+            uint32_t count; // 0: the slot is free
+        };
+
+        std::vector<Slot> slots; // a power of two, at most half full
+        size_t used = 0;         // distinct values
+        size_t total = 0;        // values counted with repeats
+        int shift = 64;
+
+        size_t home(int value) const noexcept
+        {
+            // Fibonacci hashing, the high bits of the product are well mixed
+            return (static_cast<uint64_t>(static_cast<uint32_t>(value)) * 0x9E3779B97F4A7C15ull) >> shift;
+        }
+
+        size_t mask() const noexcept { return slots.size() - 1; }
+
+        /** @returns The slot of `value`, or the free slot where it would go */
+        size_t find(int value) const noexcept
+        {
+            size_t i = home(value);
+            while (slots[i].count && slots[i].value != value)
+                i = (i + 1) & mask();
+            return i;
+        }
+
+        void rehash(size_t capacity)
+        {
+            std::vector<Slot> old = std::exchange(slots, std::vector<Slot>(capacity));
+            shift = 64 - std::countr_zero(capacity);
+            for (const Slot& slot : old)
+                if (slot.count) slots[find(slot.value)] = slot;
+        }
+
+    public:
+        CountingHashIndex() = default;
+        CountingHashIndex(const CountingHashIndex&) = default;
+        CountingHashIndex& operator=(const CountingHashIndex&) = default;
+
+        // a moved-from index is empty, its counts included
+        CountingHashIndex(CountingHashIndex&& other) noexcept
+        : slots {std::exchange(other.slots, {})}
+        , used {std::exchange(other.used, 0)}
+        , total {std::exchange(other.total, 0)}
+        , shift {std::exchange(other.shift, 64)}
+        {}
+
+        CountingHashIndex& operator=(CountingHashIndex&& other) noexcept
+        {
+            slots = std::exchange(other.slots, {});
+            used = std::exchange(other.used, 0);
+            total = std::exchange(other.total, 0);
+            shift = std::exchange(other.shift, 64);
+            return *this;
+        }
+
+        /** @brief Makes room for `n` more distinct values without rehashing */
+        void reserve(size_t n)
+        {
+            size_t needed = 2 * (used + n);
+            if (needed > slots.size())
+                rehash(std::bit_ceil(std::max<size_t>(needed, 16)));
+        }
+
+        void add(int value)
+        {
+            reserve(1);
+            Slot& slot = slots[find(value)];
+            if (!slot.count)
+            {
+                slot.value = value;
+                used++;
+            }
+            slot.count++;
+            total++;
+        }
+
+        size_t size() const noexcept { return total; }
+
+        size_t count(int value) const noexcept
+        {
+            return slots.empty() ? 0 : slots[find(value)].count;
+        }
+
+        /** @returns How many times `value` was there */
+        size_t remove(int value) noexcept
+        {
+            if (slots.empty()) return 0;
+            size_t i = find(value);
+            size_t removed = slots[i].count;
+            if (!removed) return 0;
+            for (size_t j = (i + 1) & mask(); slots[j].count; j = (j + 1) & mask())
+            {
+                // slot j may move to the hole unless its home lies between the hole and j
+                if (((j - home(slots[j].value)) & mask()) >= ((j - i) & mask()))
+                {
+                    slots[i] = slots[j];
+                    i = j;
+                }
+            }
+            slots[i].count = 0;
+            used--;
+            total -= removed;
+            return removed;
+        }
+    };
+}
 
 struct MyCollection::Impl
 {
-    std::vector<int> vec;
+    Mode mode = Mode::Unordered;
+    std::vector<int> vec;      // Mode::Unordered
+    CountingHashIndex index;   // Mode::Indexed
 
     Impl() {};
-    Impl(std::initializer_list<int> list) noexcept : vec {list} {}
+    Impl(Mode mode, std::span<const int> values) : mode {mode}
+    {
+        add(values);
+    }
 
     void add(int i)
     {
-        vec.push_back(i);
+        if (mode == Mode::Indexed)
+            index.add(i);
+        else
+            vec.push_back(i);
     }
 
     void remove(int i)
     {
-        std::erase(vec, i);
+        if (mode == Mode::Indexed)
+            index.remove(i);
+        else
+            std::erase(vec, i);
+    }
+
+    void add(std::span<const int> values)
+    {
+        if (mode == Mode::Indexed)
+        {
+            index.reserve(values.size());
+            for (int i : values) add(i);
+        }
+        else
+        {
+            vec.insert(vec.end(), values.begin(), values.end());
+        }
+    }
+
+    void remove(std::span<const int> values)
+    {
+        if (mode == Mode::Indexed)
+        {
+            for (int i : values) remove(i);
+            return;
+        }
+        // one pass over the vector instead of one per value
+        CountingHashIndex batch;
+        batch.reserve(values.size());
+        for (int i : values) batch.add(i);
+        std::erase_if(vec, [&batch](int i) { return batch.count(i) != 0; });
+    }
+
+    int count(int i) const noexcept
+    {
+        if (mode == Mode::Indexed)
+            return static_cast<int>(index.count(i));
+        return static_cast<int>(std::count(vec.begin(), vec.end(), i));
     }
 
     int size() const noexcept
     {
-        return vec.size();
+        return static_cast<int>(mode == Mode::Indexed ? index.size() : vec.size());
     }
 };
 
 MyCollection::MyCollection()
-: impl_ {std::make_unique<Impl>()}
+: impl_ {}
 {}
 
-MyCollection::MyCollection(std::initializer_list<int> l)
-: impl_(std::make_unique<Impl>(l))
+MyCollection::MyCollection(Mode mode)
+: impl_(mode, std::span<const int> {})
 {}
 
-MyCollection::MyCollection(const MyCollection& other)
-: impl_(std::make_unique<MyCollection::Impl>(*other.impl_))
+MyCollection::MyCollection(std::initializer_list<int> l, Mode mode)
+: impl_(mode, std::span<const int> {l.begin(), l.size()})
 {}
 
-MyCollection& MyCollection::operator=(const MyCollection& other)
-{
-    impl_ = std::make_unique<MyCollection::Impl>(*other.impl_);
-    return *this;
-}
+MyCollection::MyCollection(const MyCollection& other) = default;
+MyCollection& MyCollection::operator=(const MyCollection& other) = default;
+MyCollection::MyCollection(MyCollection&&) noexcept = default;
+MyCollection& MyCollection::operator=(MyCollection&&) noexcept = default;
 
 MyCollection::~MyCollection() {}
 
@@ -58,7 +224,27 @@ void MyCollection::remove(int i)
     impl_->remove(i);
 }
 
+void MyCollection::add(std::span<const int> values)
+{
+    impl_->add(values);
+}
+
+void MyCollection::remove(std::span<const int> values)
+{
+    impl_->remove(values);
+}
+
+int MyCollection::count(int i) const noexcept
+{
+    return impl_->count(i);
+}
+
 int MyCollection::size() const noexcept
 {
     return impl_->size();
-}
\ No newline at end of file
+}
+
+MyCollection::Mode MyCollection::mode() const noexcept
+{
+    return impl_->mode;
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include "Lazy.h"
 #include <initializer_list>
 #include <utility>
 #include <functional>
@@ -262,6 +263,8 @@ private:
 
     // for testing
     mutable std::atomic<int> m_timesComputed;
+
+    ConcurrentLazy<int> m_lazy { [this] { return doHeavyComputation(); } };
 public:
     CashedPower(int base = 0, int exp = 0)
     : m_base {base}, m_exp {exp}
@@ -295,6 +298,12 @@ public:
         return m_result;
     }
 
+    // no lock once computed: a single acquire load
+    int lockFree() const
+    {
+        return m_lazy.get();
+    }
+
     int timesComputed() const
     {
         return m_timesComputed;
@@ -1,11 +1,47 @@
 #pragma once
-
+#include "FastPimpl.h"
+#include "NodePool.h"
+#include "UnrolledLinkedList.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef> // ptrdiff_t
+#include <functional>
+#include <iterator>
 #include <memory>
+#include <ranges>
+#include <span>
 #include <stdexcept>
 #include <initializer_list>
 #include <type_traits>
-
-template<typename T>
+#include <utility>
+#include <vector>
+
+// 1 makes checked iterators the default for every SmartPtrLinkedList
+#ifndef SMART_PTR_LIST_CHECKED_ITERATORS
+#define SMART_PTR_LIST_CHECKED_ITERATORS 0
+#endif
+
+/**
+ * @brief Singly linked list of shared_ptr nodes.
+ *        The nodes (together with their control blocks) come from `Allocator`
+ *        through std::allocate_shared, by default from a slab pool owned by
+ *        the list. std::allocator<T> gives one heap block per node.
+ *        `CheckedIterators` selects the weak_ptr iterators described at IteratorT.
+ *
+ *        A `Persistent` list never changes a node another list can see: copies
+ *        share all nodes in O(1), elements are read-only through iterators,
+ *        and insertAfter/eraseAfter copy the nodes from the head up to the
+ *        changed one when they are shared (path copying), which makes them
+ *        O(position). pushFront and popFront stay O(1) and leave every copy
+ *        as it was. Copies share their allocator too, so a snapshot may go
+ *        to another thread only with std::allocator, the PersistentLinkedList
+ *        default; the pool of a NodePoolAllocator is single-threaded.
+ *        Relinking operations (spliceAfter, merge, sort) need a non-persistent list.
+ */
+template<typename T, typename Allocator = NodePoolAllocator<T>,
+         bool CheckedIterators = SMART_PTR_LIST_CHECKED_ITERATORS,
+         bool Persistent = false>
 class SmartPtrLinkedList
 {
     struct Node
@@ -14,9 +50,93 @@ class SmartPtrLinkedList
         std::shared_ptr<Node> next;
     };
 
+    Allocator alloc; // declared first, so it outlives `head`
     std::shared_ptr<Node> head;
+    size_t length = 0;
+
+    template<typename... Args>
+    std::shared_ptr<Node> makeNode(Args&&... args)
+    {
+        return std::allocate_shared<Node>(alloc, std::forward<Args>(args)...);
+    }
+
+    /** @brief Nodes linked to each other but not to the list yet */
+    struct Chain
+    {
+        std::shared_ptr<Node> first;
+        Node* beforeLast = nullptr; // null while `first` is the last node
+        size_t count = 0;
+
+        const std::shared_ptr<Node>& lastLink() const noexcept { return beforeLast ? beforeLast->next : first; }
+        Node* last() const noexcept { return lastLink().get(); }
+    };
+
+    /** @brief Builds the nodes for [first, last), sized ranges reserve them in the pool at once */
+    template<typename It, typename S>
+    Chain makeChain(It first, S last)
+    {
+        size_t expected = 0;
+        if constexpr (std::forward_iterator<It>)
+            expected = static_cast<size_t>(std::ranges::distance(first, last));
+
+        Chain chain;
+        for (; first != last; ++first)
+        {
+            if (!chain.first)
+                chain.first = makeNode(*first, nullptr);
+            else
+            {
+                chain.beforeLast = chain.last();
+                chain.beforeLast->next = makeNode(*first, nullptr);
+            }
+            // the pool learns its block size from the first node
+            if constexpr (requires (Allocator& a) { a.reserve(expected); })
+            {
+                if (++chain.count == 1 && expected > 1)
+                    alloc.reserve(expected - 1);
+            }
+            else ++chain.count;
+        }
+        return chain;
+    }
+
+    /**
+     * @returns true if nothing but `link` holds its node, so it may be changed in place.
+     *          A plain use_count() is a relaxed load that does not order the change after
+     *          another thread's last read of the node; taking a reference updates the
+     *          count with acq_rel (libstdc++, MSVC), the fence covers relaxed increments.
+     */
+    static bool isUnshared(const std::shared_ptr<Node>& link) noexcept
+    {
+        std::shared_ptr<Node> probe = link;
+        if (probe.use_count() != 2) return false;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return true;
+    }
+
+    /** @returns `target`, or its copy if another list shares the path from head to it */
+    Node* ownedNode(Node* target)
+    {
+        if constexpr (!Persistent) return target;
+
+        std::shared_ptr<Node>* owner = &head;
+        while (*owner && owner->get() != target && isUnshared(*owner))
+            owner = &(*owner)->next;
+        if (owner->get() == target && isUnshared(*owner))
+            return target;
+
+        // *owner is shared, so is everything after it: copy up to target
+        while (true)
+        {
+            Node* old = owner->get();
+            *owner = makeNode(old->value, old->next);
+            if (old == target) return owner->get();
+            owner = &(*owner)->next;
+        }
+    }
+
 public:
-    SmartPtrLinkedList() noexcept : head(nullptr) {}
+    SmartPtrLinkedList() noexcept(std::is_nothrow_default_constructible_v<Allocator>) : head(nullptr) {}
     ~SmartPtrLinkedList() noexcept { clear(); }
 
     SmartPtrLinkedList(std::initializer_list<T> inlist) noexcept
@@ -25,6 +145,14 @@ public:
         copy(inlist);
     }
 
+    template<std::input_iterator It, std::sentinel_for<It> S>
+    SmartPtrLinkedList(It first, S last)
+    {
+        Chain chain = makeChain(std::move(first), std::move(last));
+        head = std::move(chain.first);
+        length = chain.count;
+    }
+
     SmartPtrLinkedList(const SmartPtrLinkedList& other) noexcept
     : head(nullptr)
     {
@@ -33,106 +161,145 @@ public:
 
     SmartPtrLinkedList& operator=(const SmartPtrLinkedList& other) noexcept
     {
+        if (this == &other) return *this;
         clear();
         copy(other);
         return *this;
     }
 
+    // the pool goes along with the nodes, `other` keeps none and shares nothing with this list
     SmartPtrLinkedList(SmartPtrLinkedList&& other) noexcept
-    : head(std::move(other.head))
+    : alloc(std::move(other.alloc))
+    , head(std::move(other.head))
+    , length(std::exchange(other.length, 0))
     {}
 
-    SmartPtrLinkedList operator=(SmartPtrLinkedList&& other) noexcept
+    SmartPtrLinkedList& operator=(SmartPtrLinkedList&& other) noexcept
     {
+        clear(); // iteratively, dropping a long chain at once would recurse per node
         head = std::move(other.head);
+        length = std::exchange(other.length, 0);
+        alloc = std::move(other.alloc);
         return *this;
     }
 
 private:
-    template<template <class> class Container>
-    void copy(const Container<T>& other) noexcept
+    template<typename Container>
+    void copy(const Container& other) noexcept
     {
-        if (other.size() == 0) return;
-        auto it = other.begin();
-        head = std::make_shared<Node>(*it, nullptr);
-        auto cur = head;
-
-        while(++it != other.end())
+        if constexpr (Persistent && std::is_same_v<Container, SmartPtrLinkedList>)
         {
-            cur->next = std::make_shared<Node>(*it, nullptr);
-            cur = cur->next;
+            alloc = other.alloc;
+            head = other.head;
+            length = other.length;
+            return;
         }
+        Chain chain = makeChain(other.begin(), other.end());
+        head = std::move(chain.first);
+        length = chain.count;
     }
 public:
-    T& front()        { *begin(); }
-    T  front() const  { *cbegin(); }
+    decltype(auto) front() { return *begin(); }
+    T front() const        { return *cbegin(); }
 
     bool empty() const noexcept { return !head; }
-
-    size_t size() const noexcept
-    {
-        size_t result = 0;
-        auto it = begin();
-        while (it != end()) {
-            ++it;
-            ++result;
-        }
-        return result;
-    }
+    size_t size() const noexcept { return length; }
 
     void clear() noexcept
     {
-        while(head != nullptr)
+        // a node that another list shares ends the walk, that list frees the rest
+        while(head != nullptr && head.use_count() == 1)
         {
             head = head->next;
         }
+        head = nullptr;
+        length = 0;
+        // the slabs go back unless a copy or an iterator still holds a node
+        if constexpr (requires (Allocator& a) { a.trim(); })
+            alloc.trim();
     }
 
     struct bad_iterator : public std::exception {};
 
-    template<bool constiter> 
+    /**
+     * @brief Forward iterator over the nodes. By default it is a plain node
+     *        pointer, invalidated like any std::forward_list iterator. Checked
+     *        iterators hold a weak_ptr instead, they see when their node is
+     *        gone and throw bad_iterator, at the cost of a lock() per step.
+     */
+    template<bool constiter>
     class IteratorT
     {
-        friend class SmartPtrLinkedList<T>;
-        std::weak_ptr<Node> ptr;
+        friend class SmartPtrLinkedList;
+        template<bool> friend class IteratorT;
+
+        using Link = std::conditional_t<CheckedIterators, std::weak_ptr<Node>, Node*>;
+        Link ptr {};
+
+        static Link linkTo(const std::shared_ptr<Node>& node) noexcept
+        {
+            if constexpr (CheckedIterators) return node;
+            else return node.get();
+        }
 
-        auto node() const
+        Node* node() const
         {
-            auto shptr = ptr.lock();
-            if (!shptr) throw bad_iterator{}; 
-            return shptr;
+            if constexpr (CheckedIterators)
+            {
+                auto shptr = ptr.lock();
+                if (!shptr) throw bad_iterator{};
+                return shptr.get(); // still owned by the list
+            }
+            else return ptr;
         }
     public:
-        IteratorT() noexcept : ptr {nullptr} {}
-        IteratorT(const std::shared_ptr<Node>& node) noexcept : ptr {node} {}
-        IteratorT(const IteratorT& other) noexcept : ptr {other.ptr} {}
-        IteratorT(IteratorT&& other) noexcept : ptr {std::move(other.ptr)} {}
+        using DereferenceType = std::conditional_t<constiter || Persistent, const T&, T&>;
 
-        using DereferenceType = std::conditional<constiter, const T&, T&>;
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::remove_reference_t<DereferenceType>*;
+        using reference = DereferenceType;
 
-        T& operator*() const
+        IteratorT() noexcept = default;
+        IteratorT(const std::shared_ptr<Node>& node) noexcept : ptr {linkTo(node)} {}
+
+        DereferenceType operator*() const
         {
-           return node()->value;
+            return node()->value;
         }
 
-        T& operator->() const
+        std::remove_reference_t<DereferenceType>* operator->() const
         {
-            return *node()->value;
+            return &node()->value;
         }
 
         IteratorT& operator++()
         {
-            auto n = node();
-            ptr = n->next;
+            ptr = linkTo(node()->next);
             return *this;
         }
 
-        operator bool() const noexcept { return !ptr.expired(); }
+        IteratorT operator++(int)
+        {
+            IteratorT before = *this;
+            ++*this;
+            return before;
+        }
+
+        operator bool() const noexcept
+        {
+            if constexpr (CheckedIterators) return !ptr.expired();
+            else return ptr != nullptr;
+        }
 
         template<bool b>
         bool operator==(const IteratorT<b>& other) const noexcept
         {
-            return !ptr.owner_before(other.ptr) && !other.ptr.owner_before(ptr);
+            if constexpr (CheckedIterators)
+                return !ptr.owner_before(other.ptr) && !other.ptr.owner_before(ptr);
+            else
+                return ptr == other.ptr;
         }
 
         template<bool b>
@@ -155,83 +322,221 @@ public:
     template<bool b>
     IteratorT<b> insertAfter(IteratorT<b> it, const T& value)
     {
-        auto ptr = it.node();
-        auto next = std::make_shared<Node>(value, ptr->next);
-        ptr->next = next;
-        return ++it;
+        Node* ptr = ownedNode(it.node());
+        ptr->next = makeNode(value, ptr->next);
+        length++;
+        return IteratorT<b>{ptr->next};
     }
 
     template<bool b>
     IteratorT<b> insertAfter(IteratorT<b> it, T&& value)
     {
-        auto ptr = it.node();
-        auto next = std::make_shared<Node>(std::move(value), ptr->next);
-        ptr->next = next;
-        return ++it;
+        Node* ptr = ownedNode(it.node());
+        ptr->next = makeNode(std::move(value), ptr->next);
+        length++;
+        return IteratorT<b>{ptr->next};
     }
 
     template<bool b>
     IteratorT<b> eraseAfter(IteratorT<b> it)
     {
-        auto ptr = it.node();
+        Node* ptr = ownedNode(it.node());
         ptr->next = ptr->next->next;
-        return ++it;
+        length--;
+        return IteratorT<b>{ptr->next};
+    }
+
+    /** @returns Iterator to the last inserted element, `it` if the range is empty */
+    template<bool b, std::ranges::input_range R>
+    IteratorT<b> insertRangeAfter(IteratorT<b> it, R&& range)
+    {
+        Chain chain = makeChain(std::ranges::begin(range), std::ranges::end(range));
+        if (chain.count == 0) return it;
+        IteratorT<b> last {chain.lastLink()}; // before `first` moves
+        Node* ptr = ownedNode(it.node());
+        chain.last()->next = std::move(ptr->next);
+        ptr->next = std::move(chain.first);
+        length += chain.count;
+        return last;
+    }
+
+    template<std::ranges::input_range R>
+    void prependRange(R&& range)
+    {
+        Chain chain = makeChain(std::ranges::begin(range), std::ranges::end(range));
+        if (chain.count == 0) return;
+        chain.last()->next = std::move(head);
+        head = std::move(chain.first);
+        length += chain.count;
+    }
+
+    /** @brief Moves all nodes of `other` behind `it`, O(other.size()) to find its last node */
+    template<bool b>
+    void spliceAfter(IteratorT<b> it, SmartPtrLinkedList& other) requires (!Persistent)
+    {
+        if (!other.head || &other == this) return;
+        Node* last = other.head.get();
+        while (last->next) last = last->next.get();
+        Node* ptr = it.node();
+        last->next = std::move(ptr->next);
+        ptr->next = std::move(other.head);
+        length += std::exchange(other.length, 0);
+    }
+
+    /** @brief Moves the node after `before` out of `other` and behind `it`, O(1) */
+    template<bool b, bool b2>
+    void spliceAfter(IteratorT<b> it, SmartPtrLinkedList& other, IteratorT<b2> before) requires (!Persistent)
+    {
+        Node* from = before.node();
+        Node* to = it.node();
+        if (from == to || from->next.get() == to) return;
+        std::shared_ptr<Node> moved = std::move(from->next);
+        from->next = std::move(moved->next);
+        moved->next = std::move(to->next);
+        to->next = std::move(moved);
+        other.length--;
+        length++;
+    }
+
+    /**
+     * @brief Merges the sorted `other` into this sorted list by relinking its
+     *        nodes, O(size() + other.size()). Stable: of equal elements the
+     *        ones of this list come first.
+     */
+    template<typename Compare = std::less<>>
+    void merge(SmartPtrLinkedList& other, Compare less = {}) requires (!Persistent)
+    {
+        if (&other == this) return;
+        std::shared_ptr<Node>* link = &head;
+        std::shared_ptr<Node> rest = std::move(other.head);
+        while (rest)
+        {
+            if (!*link)
+            {
+                *link = std::move(rest);
+                break;
+            }
+            if (less(rest->value, (*link)->value))
+            {
+                std::shared_ptr<Node> taken = std::move(rest);
+                rest = std::move(taken->next);
+                taken->next = std::move(*link);
+                *link = std::move(taken);
+            }
+            link = &(*link)->next;
+        }
+        length += std::exchange(other.length, 0);
+    }
+
+    /** @brief Stable sort that relinks the nodes, the values are neither copied nor moved */
+    template<typename Compare = std::less<>>
+    void sort(Compare less = {}) requires (!Persistent)
+    {
+        std::vector<std::shared_ptr<Node>> nodes;
+        nodes.reserve(length);
+        for (std::shared_ptr<Node> node = std::move(head); node; )
+        {
+            std::shared_ptr<Node> next = std::move(node->next);
+            nodes.push_back(std::move(node));
+            node = std::move(next);
+        }
+        std::stable_sort(nodes.begin(), nodes.end(), [&less](const auto& a, const auto& b) {
+            return less(a->value, b->value);
+        });
+        for (size_t i = nodes.size(); i-- > 0; )
+        {
+            nodes[i]->next = std::move(head);
+            head = std::move(nodes[i]);
+        }
     }
 
     void pushFront(const T& value) noexcept
     {
-        auto next = std::make_shared<Node>(value, head);
-        head = next;
+        head = makeNode(value, std::move(head));
+        length++;
     }
 
     void pushFront(T&& value) noexcept
     {
-        auto next = std::make_shared<Node>(std::move(value), head);
-        head = next;
+        head = makeNode(std::move(value), std::move(head));
+        length++;
     }
 
     void popFront()
     {
         head = head->next;
+        length--;
     }
 
 };
 
-template<typename T>
-bool operator==(const SmartPtrLinkedList<T>& lhs, const SmartPtrLinkedList<T>& rhs) noexcept
+template<typename T, typename A, bool C, bool P>
+bool operator==(const SmartPtrLinkedList<T, A, C, P>& lhs, const SmartPtrLinkedList<T, A, C, P>& rhs) noexcept
 {
     auto it1 = lhs.cbegin();
     auto it2 = rhs.cbegin();
-    if (it1 == it2) return true;
     while (it1 && it2) {
+        if (it1 == it2) return true; // a shared tail
         if (*it1 != *it2) return false;
         ++it1; ++it2;
     }
     return it1 == it2; // both are nullptr
 };
 
-template<typename T>
-bool operator!=(const SmartPtrLinkedList<T>& lhs, const SmartPtrLinkedList<T>& rhs) noexcept
+template<typename T, typename A, bool C, bool P>
+bool operator!=(const SmartPtrLinkedList<T, A, C, P>& lhs, const SmartPtrLinkedList<T, A, C, P>& rhs) noexcept
 {
     return !(lhs == rhs);
 };
 
+/**
+ * @brief SmartPtrLinkedList with O(1) copies that share their nodes, see `Persistent` there.
+ *        std::allocator by default, snapshots are meant to be handed to other threads.
+ */
+template<typename T, typename Allocator = std::allocator<T>>
+using PersistentLinkedList = SmartPtrLinkedList<T, Allocator, SMART_PTR_LIST_CHECKED_ITERATORS, true>;
+
+/**
+ * @brief Multiset of ints. remove() removes every occurrence of the value.
+ *
+ * In Mode::Unordered the values are a vector in insertion order: add() is
+ * O(1), remove() scans and shifts the whole vector. Mode::Indexed counts them
+ * in an open-addressing hash table instead, which makes add(), remove() and
+ * count() O(1) on average. The batch add()/remove() take a span; in unordered
+ * mode a batch remove indexes the batch and makes a single pass over the vector.
+ */
 class MyCollection 
 {
+public:
+    enum class Mode
+    {
+        Unordered,
+        Indexed,
+    };
+
+private:
     struct Impl;
-    std::unique_ptr<Impl> impl_;
+    // room for a vector and the hash index, also with MSVC's debug iterators
+    FastPimpl<Impl, 16 * sizeof(void*), alignof(void*)> impl_;
 public:
 
     MyCollection();
-    MyCollection(std::initializer_list<int>);
+    explicit MyCollection(Mode);
+    MyCollection(std::initializer_list<int>, Mode = Mode::Unordered);
     MyCollection(const MyCollection&);
     MyCollection& operator=(const MyCollection&);
-    MyCollection(MyCollection&&) = default;
-    MyCollection& operator=(MyCollection&&) = default;
+    MyCollection(MyCollection&&) noexcept;
+    MyCollection& operator=(MyCollection&&) noexcept;
 
     ~MyCollection();
     
     void add(int i);
     void remove(int i);
+    void add(std::span<const int> values);
+    void remove(std::span<const int> values);
+
+    /** @returns How many times `i` is in the collection */
+    int count(int i) const noexcept;
     int size() const noexcept;
+    Mode mode() const noexcept;
 };
@@ -1,7 +1,13 @@
 #pragma once
 
+#include "ThreadPool.h"
+#include "StartGate.h"
+#include "ShardedCounter.h"
+#include "LatencyHistogram.h"
+
 #include <future>
 #include <thread>
+#include <vector>
 #include <atomic>
 #include <chrono>
 
@@ -48,6 +54,47 @@ inline void useAsync(   const int nThreads,
     }
 }
 
+// the same with a spin-then-sleep start gate instead of a shared_future:
+// the threads start within microseconds of each other, see gate.skew()
+template<typename TaskType>
+inline void useThreads( const int nThreads,
+                        StartGate& gate,
+                        TaskType task)
+{
+    std::vector<std::thread> threads;
+    threads.reserve(nThreads);
+
+    for (int j = 0; j < nThreads; j++)
+    {
+        threads.emplace_back([&gate, task] {
+            gate.arriveAndWait();
+            task();
+        });
+    }
+
+    gate.open(); // start all threads simultaneously
+
+    for(auto& t : threads)
+    {
+        t.join();
+    }
+}
+
+// the same with a reusable thread pool: no thread is created per call,
+// tasks beyond the pool size wait in its queue
+template<typename TaskType>
+inline void usePool(    ThreadPool& pool,
+                        const int nTasks,
+                        std::promise<void>&& promise,
+                        TaskType task)
+{
+    auto done = pool.bulk_submit(nTasks, [&task](size_t) { task(); });
+
+    promise.set_value(); // start all tasks simultaneously
+
+    done.get();
+}
+
 int multithreadVolatileIncrement(const int nThreads)
 {
     volatile int i = 0;
@@ -77,6 +124,21 @@ int multithreadAtomicIncrement(const int nThreads)
     return i;
 }
 
+// every thread adds to its own cache line instead of sharing one atomic
+long long multithreadShardedIncrement(const int nThreads)
+{
+    ShardedCounter<> i;
+    std::promise<void> p;
+    auto startFuture = p.get_future().share();
+
+    auto waitAndIncrement = [&i, startFuture] {
+        startFuture.wait();
+        i.add(1);
+    };
+    useThreads(nThreads, std::move(p), waitAndIncrement);
+    return i.read();
+}
+
 int multithreadVolatileIncrementWithAsync(const int nThreads)
 {
     volatile int i = 0;
@@ -106,6 +168,20 @@ int multithreadAtomicIncrementWithAsync(const int nThreads)
     return i;
 }
 
+int multithreadAtomicIncrementWithPool(ThreadPool& pool, const int nTasks)
+{
+    std::atomic<int> i{0};
+    std::promise<void> p;
+    auto startFuture = p.get_future().share();
+
+    auto waitAndIncrement = [&i, startFuture] {
+        startFuture.wait();
+        ++i;
+    };
+    usePool(pool, nTasks, std::move(p), waitAndIncrement);
+    return i;
+}
+
 template <typename Duration, typename T>
 inline long long elapsedTime(T startTime) noexcept
 {
@@ -0,0 +1,164 @@
+#pragma once
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint> // int64_t
+#include <exception>
+#include <future>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+/** @brief How adaptive_async ran a task */
+enum class AdaptiveLaunch
+{
+    Inline,     // right away on the calling thread, the future is ready on return
+    Deferred,   // on the thread that calls get() or wait(), like std::launch::deferred
+    Pool,       // on a ThreadPool worker
+};
+
+inline const char* toString(AdaptiveLaunch launch) noexcept
+{
+    switch (launch)
+    {
+        case AdaptiveLaunch::Inline:   return "inline";
+        case AdaptiveLaunch::Deferred: return "deferred";
+        case AdaptiveLaunch::Pool:     return "pool";
+    }
+    return "?";
+}
+
+/**
+ * @brief Recent run time of the tasks launched from one call site,
+ *        and the launch it suggests for the next one
+ */
+class AdaptiveCallSite
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    /** @brief Tasks shorter than this cost less than a hand-off to another thread */
+    static constexpr clock::duration INLINE_BELOW = std::chrono::microseconds(5);
+
+private:
+    static constexpr int64_t UNKNOWN = -1;
+
+    // racy read-modify-write on purpose: a lost sample does not matter here
+    std::atomic<int64_t> recentNs {UNKNOWN};
+    std::atomic<AdaptiveLaunch> last {AdaptiveLaunch::Pool};
+
+public:
+    /** @brief Folds one run into the moving average, a new run weighs 1/8 */
+    void record(clock::duration runTime) noexcept
+    {
+        int64_t sample = std::chrono::duration_cast<std::chrono::nanoseconds>(runTime).count();
+        int64_t old = recentNs.load(std::memory_order_relaxed);
+        recentNs.store(old == UNKNOWN ? sample : old + (sample - old) / 8, std::memory_order_relaxed);
+    }
+
+    /** @returns Moving average of the run time, std::nullopt before the first run */
+    std::optional<clock::duration> recent() const noexcept
+    {
+        int64_t ns = recentNs.load(std::memory_order_relaxed);
+        if (ns == UNKNOWN) return std::nullopt;
+        return std::chrono::duration_cast<clock::duration>(std::chrono::nanoseconds(ns));
+    }
+
+    /**
+     * @returns Inline for tasks known to be tiny. Deferred on the pool's own
+     *          workers, whose waiting on a job queued behind them can deadlock
+     *          the pool, and when no worker is idle, as the task would only wait
+     *          for the backlog. Pool otherwise, also while the run time is unknown.
+     */
+    AdaptiveLaunch choose(const ThreadPool& pool) const noexcept
+    {
+        auto time = recent();
+        if (time && *time < INLINE_BELOW)
+            return AdaptiveLaunch::Inline;
+        if (pool.isWorkerThread() || pool.idleCount() == 0)
+            return AdaptiveLaunch::Deferred;
+        return AdaptiveLaunch::Pool;
+    }
+
+    /** @returns The launch of the latest task from this call site */
+    AdaptiveLaunch lastLaunch() const noexcept { return last.load(std::memory_order_relaxed); }
+
+    void setLastLaunch(AdaptiveLaunch launch) noexcept { last.store(launch, std::memory_order_relaxed); }
+};
+
+/** @brief Statistics of the call sites that launch `F`, every lambda is its own call site */
+template<typename F>
+AdaptiveCallSite& adaptiveCallSite() noexcept
+{
+    static AdaptiveCallSite site;
+    return site;
+}
+
+/** @brief Pool of the adaptive_async overload that takes none */
+inline ThreadPool& adaptivePool()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+/**
+ * @brief Like std::async, but picks the launch from the recent run time of `F`
+ *        (see AdaptiveCallSite::choose), so tiny tasks stop paying for a thread hand-off
+ * @returns Future with the result or the exception thrown by `fn`
+ */
+template<typename F>
+std::future<std::invoke_result_t<F&>> adaptive_async(ThreadPool& pool, F fn)
+{
+    using R = std::invoke_result_t<F&>;
+    using clock = AdaptiveCallSite::clock;
+
+    AdaptiveCallSite& site = adaptiveCallSite<F>();
+    auto timed = [&site, fn = std::move(fn)]() mutable -> R {
+        struct Timer
+        {
+            AdaptiveCallSite& site;
+            clock::time_point start = clock::now();
+            ~Timer() { site.record(clock::now() - start); } // failed runs count too
+        } timer { site };
+        return fn();
+    };
+
+    AdaptiveLaunch launch = site.choose(pool);
+    site.setLastLaunch(launch);
+    switch (launch)
+    {
+        case AdaptiveLaunch::Inline:
+        {
+            std::promise<R> promise;
+            try
+            {
+                if constexpr (std::is_void_v<R>)
+                {
+                    timed();
+                    promise.set_value();
+                }
+                else
+                {
+                    promise.set_value(timed());
+                }
+            }
+            catch (...)
+            {
+                promise.set_exception(std::current_exception());
+            }
+            return promise.get_future();
+        }
+        case AdaptiveLaunch::Deferred:
+            return std::async(std::launch::deferred, std::move(timed));
+        case AdaptiveLaunch::Pool:
+        default:
+            return pool.submit(std::move(timed));
+    }
+}
+
+template<typename F>
+std::future<std::invoke_result_t<F&>> adaptive_async(F fn)
+{
+    return adaptive_async(adaptivePool(), std::move(fn));
+}
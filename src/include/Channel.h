@@ -0,0 +1,264 @@
+#pragma once
+#include "util.h"
+#include "RunLoop.h"
+#include "ConcurrentQueue.h"
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef> // size_t
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief Bounded multi-producer multi-consumer channel with co_await-able
+ *        send() and receive().
+ *
+ * Values go through a lock-free MpmcQueue. A coroutine is parked only when
+ * the buffer is full (send) or empty (receive); the mutex guards the parked
+ * waiter lists only, so the fast path never takes it. A coroutine parked
+ * while running on a RunLoop (including syncWait()) is resumed on that loop,
+ * otherwise inline on the thread that unblocked it.
+ *
+ * close() is a cancellation signal for both sides: pending and future sends
+ * fail, receivers drain what is buffered and then get std::nullopt.
+ * Values sent concurrently with close() may be dropped.
+ */
+template<typename T>
+class Channel
+{
+    struct Waiter : RunLoop::Operation
+    {
+        RunLoop* loop = nullptr;
+
+        Waiter* nextWaiter() const noexcept { return static_cast<Waiter*>(next); }
+
+        void resume()
+        {
+            if (loop) loop->post(*this);
+            else      handle.resume();
+        }
+    };
+
+    // intrusive FIFO, parked awaitables live in the coroutine frames
+    struct WaiterList
+    {
+        Waiter* head = nullptr;
+        Waiter* tail = nullptr;
+
+        bool empty() const noexcept { return !head; }
+
+        template<typename W>
+        W* front() const noexcept { return static_cast<W*>(head); }
+
+        void pushBack(Waiter* w) noexcept
+        {
+            w->next = nullptr;
+            if (tail) tail->next = w;
+            else      head = w;
+            tail = w;
+        }
+
+        Waiter* popFront() noexcept
+        {
+            Waiter* w = head;
+            if (w)
+            {
+                head = w->nextWaiter();
+                if (!head) tail = nullptr;
+            }
+            return w;
+        }
+    };
+
+    MpmcQueue<T> buffer;
+    std::atomic<bool> closed {false};
+    std::atomic<size_t> parked {0};
+    std::mutex mutex;
+    WaiterList senders;
+    WaiterList receivers;
+
+    class SendAwaitable : Waiter
+    {
+        friend class Channel;
+        Channel& channel;
+        T value;
+        bool sent = false;
+
+    public:
+        SendAwaitable(Channel& c, T&& v) noexcept
+        : channel {c}, value {std::move(v)}
+        {}
+
+        bool await_ready() noexcept
+        {
+            if (channel.closed.load(std::memory_order_acquire))
+                return true;
+            sent = channel.buffer.tryPush(std::move(value));
+            return sent;
+        }
+
+        bool await_suspend(std::coroutine_handle<> coro)
+        {
+            std::lock_guard lock {channel.mutex};
+            channel.announceParking();
+            if (channel.closed.load(std::memory_order_acquire)
+                || (sent = channel.buffer.tryPush(std::move(value))))
+            {
+                channel.parked.fetch_sub(1, std::memory_order_relaxed);
+                return false;
+            }
+            this->handle = coro;
+            this->loop = RunLoop::current();
+            channel.senders.pushBack(this);
+            return true;
+        }
+
+        /** @returns false if the channel was closed and the value was dropped */
+        bool await_resume()
+        {
+            if (sent) channel.wakeWaiters();
+            return sent;
+        }
+    };
+
+    class ReceiveAwaitable : Waiter
+    {
+        friend class Channel;
+        Channel& channel;
+        std::optional<T> result;
+
+    public:
+        explicit ReceiveAwaitable(Channel& c) noexcept
+        : channel {c}
+        {}
+
+        bool await_ready() noexcept
+        {
+            // acquire pairs with close(): seeing the close means seeing every value sent before it
+            bool wasClosed = channel.closed.load(std::memory_order_acquire);
+            result = channel.buffer.tryPop();
+            return result || wasClosed;
+        }
+
+        bool await_suspend(std::coroutine_handle<> coro)
+        {
+            std::lock_guard lock {channel.mutex};
+            channel.announceParking();
+            bool wasClosed = channel.closed.load(std::memory_order_acquire);
+            if ((result = channel.buffer.tryPop()) || wasClosed)
+            {
+                channel.parked.fetch_sub(1, std::memory_order_relaxed);
+                return false;
+            }
+            this->handle = coro;
+            this->loop = RunLoop::current();
+            channel.receivers.pushBack(this);
+            return true;
+        }
+
+        /** @returns std::nullopt if the channel is closed and drained */
+        std::optional<T> await_resume()
+        {
+            if (result) channel.wakeWaiters();
+            return std::move(result);
+        }
+    };
+
+    // Pairs with the fence in wakeWaiters(): either the parking coroutine sees
+    // the buffer change in its re-check, or the other side sees it parked.
+    void announceParking() noexcept
+    {
+        parked.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    /**
+     * @brief Hands buffered values to parked receivers and free slots
+     *        to parked senders after the buffer has changed
+     */
+    void wakeWaiters()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (parked.load(std::memory_order_relaxed) == 0)
+            return;
+
+        WaiterList ready;
+        {
+            std::lock_guard lock {mutex};
+            bool progress = true;
+            while (progress)
+            {
+                progress = false;
+                if (auto* r = receivers.template front<ReceiveAwaitable>())
+                {
+                    if ((r->result = buffer.tryPop()))
+                    {
+                        ready.pushBack(receivers.popFront());
+                        progress = true;
+                    }
+                }
+                if (auto* s = senders.template front<SendAwaitable>())
+                {
+                    if ((s->sent = buffer.tryPush(std::move(s->value))))
+                    {
+                        ready.pushBack(senders.popFront());
+                        progress = true;
+                    }
+                }
+            }
+
+            if (closed.load(std::memory_order_acquire))
+            {
+                while (Waiter* r = receivers.popFront()) ready.pushBack(r);
+                while (Waiter* s = senders.popFront())   ready.pushBack(s);
+            }
+        }
+
+        while (Waiter* w = ready.popFront())
+        {
+            parked.fetch_sub(1, std::memory_order_relaxed);
+            w->resume(); // `w` may be destroyed after this
+        }
+    }
+
+public:
+    /** @param capacity Max number of buffered values, rounded up to a power of two */
+    explicit Channel(size_t capacity)
+    : buffer {capacity}
+    {}
+
+    Channel(const Channel&) = delete;
+    Channel& operator=(const Channel&) = delete;
+
+    size_t capacity() const noexcept { return buffer.capacity(); }
+
+    bool isClosed() const noexcept { return closed.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Suspends while the channel is full
+     * @returns Awaitable yielding false if the channel has been closed
+     */
+    [[nodiscard]] SendAwaitable send(T value) noexcept
+    {
+        return SendAwaitable { *this, std::move(value) };
+    }
+
+    /**
+     * @brief Suspends while the channel is empty
+     * @returns Awaitable yielding std::nullopt once the channel is closed and drained
+     */
+    [[nodiscard]] ReceiveAwaitable receive() noexcept
+    {
+        return ReceiveAwaitable { *this };
+    }
+
+    /** @brief Wakes all parked senders and receivers, see class description */
+    void close()
+    {
+        closed.store(true, std::memory_order_release);
+        wakeWaiters();
+    }
+};
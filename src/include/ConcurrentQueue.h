@@ -0,0 +1,386 @@
+#pragma once
+#include "util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef> // size_t
+#include <cstdint> // intptr_t, uint32_t
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief Lets threads sleep until "something changed" without a mutex.
+ *
+ * A waiter calls prepareWait(), retries its condition, then either
+ * cancelWait(key) or wait(key). A notifier changes the state first and then
+ * calls notifyOne() or notify(), which cost a fence and a load while nobody
+ * sleeps. The fences on both sides make sure that either the retry sees the
+ * change or the notifier sees the waiter, so no wake-up is lost.
+ *
+ * notifyOne() wakes a single sleeper for a single new item; notify() wakes
+ * all of them, for state changes every waiter must see (close, shutdown).
+ * Waiters sleep on a 32-bit epoch, the width the futex works on directly,
+ * and unregister themselves once they stop waiting.
+ */
+class EventCount
+{
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> epoch {0};
+    std::atomic<uint32_t> waiters {0};
+
+    /** @returns false if nobody is waiting and there is nobody to wake */
+    bool advance() noexcept
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) == 0)
+            return false;
+        epoch.fetch_add(1, std::memory_order_release);
+        return true;
+    }
+
+public:
+    [[nodiscard]] uint32_t prepareWait() noexcept
+    {
+        waiters.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        // acquire: a key that already includes a notification also shows its change
+        return epoch.load(std::memory_order_acquire);
+    }
+
+    void cancelWait(uint32_t /*key*/) noexcept
+    {
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    /** @brief Sleeps unless a notification came after prepareWait() returned `key` */
+    void wait(uint32_t key) noexcept
+    {
+        while (epoch.load(std::memory_order_acquire) == key)
+            epoch.wait(key, std::memory_order_acquire);
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    /** @brief Wakes one sleeping waiter, if any */
+    void notifyOne() noexcept
+    {
+        if (advance())
+            epoch.notify_one();
+    }
+
+    /** @brief Wakes every waiter */
+    void notify() noexcept
+    {
+        if (advance())
+            epoch.notify_all();
+    }
+};
+
+/**
+ * @brief Bounded lock-free MPMC queue (Dmitry Vyukov's algorithm).
+ *        Every cell has a sequence number that tells producers and consumers
+ *        whose turn it is, so head and tail are the only contended words,
+ *        each on its own cache line.
+ */
+template<typename T>
+class MpmcQueue
+{
+    static_assert(std::is_nothrow_move_constructible_v<T>,
+        "values are moved into reserved slots and must not throw");
+
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        alignas(T) std::byte storage[sizeof(T)];
+
+        T* value() noexcept { return std::launder(reinterpret_cast<T*>(storage)); }
+    };
+
+    const size_t mask;
+    std::unique_ptr<Cell[]> cells;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> enqueuePos {0};
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> dequeuePos {0};
+
+public:
+    using value_type = T;
+
+    /** @param capacity Is rounded up to the nearest power of two */
+    explicit MpmcQueue(size_t capacity)
+    : mask { std::bit_ceil(std::max<size_t>(capacity, 1)) - 1 }
+    , cells { std::make_unique<Cell[]>(mask + 1) }
+    {
+        for (size_t i = 0; i <= mask; i++)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    ~MpmcQueue()
+    {
+        while (tryPop()) {}
+    }
+
+    size_t capacity() const noexcept { return mask + 1; }
+
+    /** @returns false if the queue is full, `value` is left untouched then */
+    bool tryPush(T&& value) noexcept
+    {
+        Cell* cell;
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            cell = &cells[pos & mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false; // full
+            }
+            else
+            {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        ::new (static_cast<void*>(cell->storage)) T(std::move(value));
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** @returns std::nullopt if the queue is empty */
+    std::optional<T> tryPop() noexcept
+    {
+        Cell* cell;
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            cell = &cells[pos & mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0)
+            {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return std::nullopt; // empty
+            }
+            else
+            {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        std::optional<T> result { std::move(*cell->value()) };
+        cell->value()->~T();
+        cell->sequence.store(pos + mask + 1, std::memory_order_release);
+        return result;
+    }
+};
+
+/**
+ * @brief Bounded wait-free single-producer single-consumer queue.
+ *        Each side owns its index on its own cache line and keeps a cached
+ *        copy of the other side's index, so it reads the shared one only
+ *        when the queue looks full (producer) or empty (consumer).
+ *        tryPush() must only be called from one thread, tryPop() from one thread.
+ */
+template<typename T>
+class SpscQueue
+{
+    static_assert(std::is_nothrow_move_constructible_v<T>,
+        "values are moved into reserved slots and must not throw");
+
+    struct Cell
+    {
+        alignas(T) std::byte storage[sizeof(T)];
+
+        T* value() noexcept { return std::launder(reinterpret_cast<T*>(storage)); }
+    };
+
+    struct alignas(CACHE_LINE_SIZE) Producer
+    {
+        std::atomic<size_t> tail {0};
+        size_t cachedHead = 0;
+    };
+
+    struct alignas(CACHE_LINE_SIZE) Consumer
+    {
+        std::atomic<size_t> head {0};
+        size_t cachedTail = 0;
+    };
+
+    const size_t mask;
+    std::unique_ptr<Cell[]> cells;
+    Producer producer;
+    Consumer consumer;
+
+public:
+    using value_type = T;
+
+    /** @param capacity Is rounded up to the nearest power of two */
+    explicit SpscQueue(size_t capacity)
+    : mask { std::bit_ceil(std::max<size_t>(capacity, 1)) - 1 }
+    , cells { std::make_unique<Cell[]>(mask + 1) }
+    {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    ~SpscQueue()
+    {
+        while (tryPop()) {}
+    }
+
+    size_t capacity() const noexcept { return mask + 1; }
+
+    /** @returns false if the queue is full, `value` is left untouched then */
+    bool tryPush(T&& value) noexcept
+    {
+        size_t tail = producer.tail.load(std::memory_order_relaxed);
+        if (tail - producer.cachedHead > mask)
+        {
+            producer.cachedHead = consumer.head.load(std::memory_order_acquire);
+            if (tail - producer.cachedHead > mask)
+                return false; // full
+        }
+        ::new (static_cast<void*>(cells[tail & mask].storage)) T(std::move(value));
+        producer.tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** @returns std::nullopt if the queue is empty */
+    std::optional<T> tryPop() noexcept
+    {
+        size_t head = consumer.head.load(std::memory_order_relaxed);
+        if (head == consumer.cachedTail)
+        {
+            consumer.cachedTail = producer.tail.load(std::memory_order_acquire);
+            if (head == consumer.cachedTail)
+                return std::nullopt; // empty
+        }
+        T* value = cells[head & mask].value();
+        std::optional<T> result { std::move(*value) };
+        value->~T();
+        consumer.head.store(head + 1, std::memory_order_release);
+        return result;
+    }
+};
+
+/**
+ * @brief Adds blocking push()/pop() and close() to MpmcQueue or SpscQueue.
+ *
+ * A blocked thread spins briefly, then sleeps on an EventCount; the try
+ * variants stay lock-free and only pay for a wake-up check. Same threading
+ * rules as the wrapped queue.
+ */
+template<typename Queue>
+class BlockingQueue
+{
+public:
+    using value_type = typename Queue::value_type;
+
+private:
+    static constexpr int SPIN_COUNT = 128;
+
+    Queue queue;
+    EventCount notFull;
+    EventCount notEmpty;
+    std::atomic<bool> closed {false};
+
+public:
+    explicit BlockingQueue(size_t capacity) : queue {capacity} {}
+
+    size_t capacity() const noexcept { return queue.capacity(); }
+
+    bool tryPush(value_type&& value) noexcept
+    {
+        if (closed.load(std::memory_order_acquire) || !queue.tryPush(std::move(value)))
+            return false;
+        notEmpty.notifyOne();
+        return true;
+    }
+
+    std::optional<value_type> tryPop() noexcept
+    {
+        auto value = queue.tryPop();
+        if (value) notFull.notifyOne();
+        return value;
+    }
+
+    /**
+     * @brief Waits while the queue is full
+     * @returns false if the queue was closed, `value` is left untouched then
+     */
+    bool push(value_type&& value) noexcept
+    {
+        for (int i = 0; i < SPIN_COUNT; i++)
+        {
+            if (tryPush(std::move(value))) return true;
+            if (closed.load(std::memory_order_acquire)) return false;
+            cpuRelax();
+        }
+        while (true)
+        {
+            uint32_t key = notFull.prepareWait();
+            if (tryPush(std::move(value)))
+            {
+                notFull.cancelWait(key);
+                return true;
+            }
+            if (closed.load(std::memory_order_acquire))
+            {
+                notFull.cancelWait(key);
+                return false;
+            }
+            notFull.wait(key);
+        }
+    }
+
+    /**
+     * @brief Waits while the queue is empty
+     * @returns std::nullopt once the queue is closed and drained
+     */
+    std::optional<value_type> pop() noexcept
+    {
+        for (int i = 0; i < SPIN_COUNT; i++)
+        {
+            if (auto value = tryPop()) return value;
+            cpuRelax();
+        }
+        while (true)
+        {
+            uint32_t key = notEmpty.prepareWait();
+            if (auto value = tryPop())
+            {
+                notEmpty.cancelWait(key);
+                return value;
+            }
+            if (closed.load(std::memory_order_acquire))
+            {
+                notEmpty.cancelWait(key);
+                return tryPop(); // a push may have slipped in before close()
+            }
+            notEmpty.wait(key);
+        }
+    }
+
+    /** @brief Fails all further pushes and wakes every blocked thread */
+    void close() noexcept
+    {
+        closed.store(true, std::memory_order_release);
+        notFull.notify();
+        notEmpty.notify();
+    }
+
+    bool isClosed() const noexcept { return closed.load(std::memory_order_acquire); }
+};
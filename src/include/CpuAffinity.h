@@ -0,0 +1,141 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <new>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/**
+ * @brief Restricts the calling thread to a set of logical CPUs, e.g. the CPUs
+ *        of one NUMA node, so the scheduler only migrates it within that set
+ * @returns false if pinning is not supported here or a CPU does not exist
+ */
+inline bool pinCurrentThreadToCpus(const std::vector<unsigned>& cpus) noexcept
+{
+    if (cpus.empty()) return false;
+#if defined(_WIN32)
+    DWORD_PTR mask = 0;
+    for (unsigned cpu : cpus)
+    {
+        if (cpu >= sizeof(DWORD_PTR) * 8) return false;
+        mask |= DWORD_PTR{1} << cpu;
+    }
+    return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (unsigned cpu : cpus)
+    {
+        if (cpu >= CPU_SETSIZE) return false;
+        CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Pins the calling thread to one logical CPU, so the scheduler stops
+ *        migrating it (and its cache contents) between cores
+ * @returns false if pinning is not supported here or the CPU does not exist
+ */
+inline bool pinCurrentThreadToCpu(unsigned cpu) noexcept
+{
+    try
+    {
+        return pinCurrentThreadToCpus({ cpu });
+    }
+    catch (const std::bad_alloc&)
+    {
+        return false;
+    }
+}
+
+/** @returns Number of logical CPUs, at least 1 */
+inline unsigned cpuCount() noexcept
+{
+    unsigned n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+/** @brief Logical CPUs that share one memory controller */
+struct NumaNode
+{
+    unsigned id;
+    std::vector<unsigned> cpus;
+};
+
+/** @brief Parses the kernel's cpu list format, e.g. "0-3,8,10-11" */
+inline std::vector<unsigned> parseCpuList(std::string_view list)
+{
+    std::vector<unsigned> cpus;
+    while (!list.empty())
+    {
+        std::string_view range = list.substr(0, list.find(','));
+        list.remove_prefix(std::min(range.size() + 1, list.size()));
+
+        unsigned first = 0, last = 0;
+        const char* end = range.data() + range.size();
+        auto [p, ec] = std::from_chars(range.data(), end, first);
+        if (ec != std::errc{}) continue; // e.g. the trailing newline
+        last = first;
+        if (p != end && *p == '-')
+            std::from_chars(p + 1, end, last);
+        for (unsigned cpu = first; cpu <= last; cpu++)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+/**
+ * @brief NUMA nodes of this machine and their CPUs, ordered by node id.
+ *        Reads sysfs on Linux; elsewhere, or when that fails, reports one
+ *        node that holds every CPU, which makes node placement a no-op.
+ */
+inline std::vector<NumaNode> numaNodes()
+{
+    std::vector<NumaNode> nodes;
+#if defined(__linux__)
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator{"/sys/devices/system/node", ec})
+    {
+        std::string name = entry.path().filename().string();
+        if (!name.starts_with("node") || name.size() == 4
+            || !std::all_of(name.begin() + 4, name.end(), [](char c) { return c >= '0' && c <= '9'; }))
+            continue;
+
+        std::ifstream file { entry.path() / "cpulist" };
+        std::string list;
+        if (!std::getline(file, list)) continue;
+        auto cpus = parseCpuList(list);
+        if (!cpus.empty()) // memory-only nodes have no CPUs
+            nodes.push_back({ static_cast<unsigned>(std::stoul(name.substr(4))), std::move(cpus) });
+    }
+    std::sort(nodes.begin(), nodes.end(), [](auto& a, auto& b) { return a.id < b.id; });
+#endif
+    if (nodes.empty())
+    {
+        NumaNode all { 0, {} };
+        for (unsigned cpu = 0; cpu < cpuCount(); cpu++)
+            all.cpus.push_back(cpu);
+        nodes.push_back(std::move(all));
+    }
+    return nodes;
+}
@@ -0,0 +1,200 @@
+#pragma once
+#include "util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef> // size_t
+#include <cstdint> // uint64_t
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Safe memory reclamation for lock-free structures with epochs (Fraser, 2004).
+ *
+ * Threads read shared nodes only inside a Guard, which pins the global epoch
+ * the thread saw on entry. A node unlinked from a structure is retired with
+ * the current epoch instead of deleted. The epoch advances once every pinned
+ * thread has seen it, so after two advances no thread can still hold a
+ * pointer to the nodes retired before them, and they are deleted.
+ *
+ * Readers pay one fence per guard instead of one per node like hazard
+ * pointers, which makes long traversals cheap. The price: a thread that
+ * stays inside a guard keeps every retired node alive until it leaves.
+ *
+ * There is one process-wide domain. Retired nodes left behind by exiting
+ * threads are adopted by the next thread that reclaims.
+ */
+class EpochReclaimer
+{
+    static constexpr uint64_t IDLE = ~uint64_t{0};
+    static constexpr size_t RECLAIM_THRESHOLD = 64;
+
+    struct alignas(CACHE_LINE_SIZE) Record
+    {
+        std::atomic<uint64_t> pinned {IDLE};
+        std::atomic<bool> active {true};
+        Record* next = nullptr; // never changes once the record is published
+    };
+
+    struct Retired
+    {
+        void* ptr;
+        void (*destroy)(void*);
+        uint64_t epoch;
+    };
+
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> epoch {0};
+    std::atomic<Record*> records {nullptr};
+    std::mutex orphansMutex;
+    std::vector<Retired> orphans;
+    std::atomic<bool> hasOrphans {false};
+
+    /** @brief The calling thread's record and retired nodes */
+    struct ThreadState
+    {
+        Record* record = nullptr;
+        size_t depth = 0; // nested guards
+        std::vector<Retired> retired;
+        size_t reclaimAt = RECLAIM_THRESHOLD; // grows while a pinned thread holds the nodes back
+
+        ~ThreadState()
+        {
+            EpochReclaimer& domain = instance();
+            if (record) record->active.store(false, std::memory_order_release);
+            domain.reclaim(retired);
+            if (!retired.empty())
+            {
+                std::lock_guard lock {domain.orphansMutex};
+                domain.orphans.insert(domain.orphans.end(), retired.begin(), retired.end());
+                domain.hasOrphans.store(true, std::memory_order_release);
+            }
+        }
+    };
+
+    static ThreadState& threadState()
+    {
+        instance(); // constructed first, so it is destroyed after every thread's state
+        thread_local ThreadState state;
+        return state;
+    }
+
+    Record* acquire()
+    {
+        for (Record* r = records.load(std::memory_order_acquire); r; r = r->next)
+        {
+            bool inactive = false;
+            if (!r->active.load(std::memory_order_relaxed)
+                && r->active.compare_exchange_strong(inactive, true, std::memory_order_acquire))
+                return r;
+        }
+        Record* r = new Record;
+        r->next = records.load(std::memory_order_relaxed);
+        while (!records.compare_exchange_weak(r->next, r, std::memory_order_release, std::memory_order_relaxed)) {}
+        return r;
+    }
+
+    /** @returns The global epoch, advanced by one if every pinned thread has seen it */
+    uint64_t tryAdvance() noexcept
+    {
+        uint64_t current = epoch.load();
+        for (Record* r = records.load(std::memory_order_acquire); r; r = r->next)
+        {
+            uint64_t pinned = r->pinned.load();
+            if (pinned != IDLE && pinned != current)
+                return current;
+        }
+        epoch.compare_exchange_strong(current, current + 1);
+        return epoch.load();
+    }
+
+    /** @brief Deletes the nodes of `retired` that were retired two epochs ago */
+    void reclaim(std::vector<Retired>& retired)
+    {
+        if (hasOrphans.load(std::memory_order_acquire))
+        {
+            std::lock_guard lock {orphansMutex};
+            retired.insert(retired.end(), orphans.begin(), orphans.end());
+            orphans.clear();
+            hasOrphans.store(false, std::memory_order_relaxed);
+        }
+
+        uint64_t current = tryAdvance();
+        auto kept = std::partition(retired.begin(), retired.end(), [current](const Retired& node) {
+            return node.epoch + 2 > current;
+        });
+        for (auto it = kept; it != retired.end(); ++it)
+            it->destroy(it->ptr);
+        retired.erase(kept, retired.end());
+    }
+
+    EpochReclaimer() = default;
+
+    ~EpochReclaimer()
+    {
+        // static destruction: no thread is left inside a guard
+        for (Retired& node : orphans)
+            node.destroy(node.ptr);
+        for (Record* r = records.load(); r; )
+            delete std::exchange(r, r->next);
+    }
+
+public:
+    EpochReclaimer(const EpochReclaimer&) = delete;
+    EpochReclaimer& operator=(const EpochReclaimer&) = delete;
+
+    static EpochReclaimer& instance()
+    {
+        static EpochReclaimer domain;
+        return domain;
+    }
+
+    /** @brief Pins the current epoch for the calling thread, guards nest */
+    class Guard
+    {
+        ThreadState& state;
+
+    public:
+        Guard() : state {threadState()}
+        {
+            if (state.depth++ > 0) return;
+            if (!state.record) state.record = instance().acquire();
+            state.record->pinned.store(instance().epoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            // the pin is visible before we load any shared pointer
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+
+        ~Guard()
+        {
+            if (--state.depth == 0)
+                state.record->pinned.store(IDLE, std::memory_order_release);
+        }
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+    };
+
+    /** @brief Deletes `p` with `delete` once no guard that could have seen it is left */
+    template<typename T>
+    static void retire(T* p)
+    {
+        ThreadState& state = threadState();
+        EpochReclaimer& domain = instance();
+        state.retired.push_back({ p, [](void* ptr) { delete static_cast<T*>(ptr); }, domain.epoch.load() });
+        if (state.retired.size() >= state.reclaimAt)
+        {
+            domain.reclaim(state.retired);
+            state.reclaimAt = state.retired.size() + RECLAIM_THRESHOLD;
+        }
+    }
+
+    /**
+     * @brief Deletes what the calling thread (and every exited thread) retired,
+     *        as far as possible. Called outside of guards, every call advances
+     *        the epoch at most once, so it takes two to free everything.
+     */
+    static void collect()
+    {
+        instance().reclaim(threadState().retired);
+    }
+};
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <exception>
+#include <utility>
+#include <variant>
+#include <type_traits>
+
+#if __has_include(<expected>)
+#include <expected>
+#endif
+
+/**
+ * Value-or-error result type for failures that are ordinary outcomes
+ * (e.g. "no files matched") and should not pay for throw/catch/rethrow.
+ *
+ * Aliases std::expected when the standard library provides it (C++23),
+ * otherwise a minimal subset with the same interface is provided, so the
+ * code using it does not change when the project moves to C++23.
+ */
+#if defined(__cpp_lib_expected) && __cpp_lib_expected >= 202202L
+
+template<typename E>
+using Unexpected = std::unexpected<E>;
+
+template<typename T, typename E>
+using Expected = std::expected<T, E>;
+
+#else
+
+template<typename E>
+class Unexpected
+{
+    E err;
+public:
+    constexpr explicit Unexpected(E e) noexcept(std::is_nothrow_move_constructible_v<E>)
+    : err {std::move(e)}
+    {}
+
+    constexpr const E& error() const & noexcept { return err; }
+    constexpr E&       error() &       noexcept { return err; }
+    constexpr E&&      error() &&      noexcept { return std::move(err); }
+};
+
+struct BadExpectedAccess : public std::exception
+{
+    const char* what() const noexcept override { return "bad Expected access"; }
+};
+
+template<typename T, typename E>
+class Expected
+{
+    static constexpr size_t VALUE = 0;
+    static constexpr size_t ERROR = 1;
+
+    std::variant<T, E> storage;
+
+public:
+    using value_type = T;
+    using error_type = E;
+
+    constexpr Expected() requires std::is_default_constructible_v<T>
+    : storage {std::in_place_index<VALUE>}
+    {}
+
+    template<typename U = T>
+    requires (std::is_constructible_v<T, U&&> && !std::is_same_v<std::remove_cvref_t<U>, Expected>)
+    constexpr Expected(U&& value)
+    : storage {std::in_place_index<VALUE>, std::forward<U>(value)}
+    {}
+
+    template<typename G>
+    constexpr Expected(Unexpected<G> unexpected)
+    : storage {std::in_place_index<ERROR>, std::move(unexpected).error()}
+    {}
+
+    constexpr bool has_value() const noexcept { return storage.index() == VALUE; }
+    constexpr explicit operator bool() const noexcept { return has_value(); }
+
+    constexpr T& value() &
+    {
+        if (!has_value()) throw BadExpectedAccess{};
+        return *std::get_if<VALUE>(&storage);
+    }
+
+    constexpr const T& value() const &
+    {
+        if (!has_value()) throw BadExpectedAccess{};
+        return *std::get_if<VALUE>(&storage);
+    }
+
+    constexpr T&& value() &&
+    {
+        if (!has_value()) throw BadExpectedAccess{};
+        return std::move(*std::get_if<VALUE>(&storage));
+    }
+
+    template<typename U>
+    constexpr T value_or(U&& fallback) const &
+    {
+        return has_value() ? **this : static_cast<T>(std::forward<U>(fallback));
+    }
+
+    // unchecked accessors, like std::expected
+    constexpr T&        operator*() &        noexcept { return *std::get_if<VALUE>(&storage); }
+    constexpr const T&  operator*() const &  noexcept { return *std::get_if<VALUE>(&storage); }
+    constexpr T&&       operator*() &&       noexcept { return std::move(*std::get_if<VALUE>(&storage)); }
+    constexpr T*        operator->()         noexcept { return std::get_if<VALUE>(&storage); }
+    constexpr const T*  operator->() const   noexcept { return std::get_if<VALUE>(&storage); }
+
+    constexpr E&        error() &        noexcept { return *std::get_if<ERROR>(&storage); }
+    constexpr const E&  error() const &  noexcept { return *std::get_if<ERROR>(&storage); }
+    constexpr E&&       error() &&       noexcept { return std::move(*std::get_if<ERROR>(&storage)); }
+};
+
+#endif
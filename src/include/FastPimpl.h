@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef> // size_t, byte, max_align_t
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief Pointer to implementation that keeps the implementation inside the
+ *        object, in `Size` bytes aligned to `Align`, instead of on the heap.
+ *
+ * The header of the owning class names only `Size` and `Align`, so `T` stays
+ * incomplete there like with std::unique_ptr<Impl>. Everything that touches
+ * the `T`, including the owner's copy, move and destructor, must be defined
+ * where `T` is complete, i.e. in the .cpp. The destructor checks at compile
+ * time that `T` fits; if it does not, the error names the sizes to use.
+ *
+ * Unlike a unique_ptr a FastPimpl is never empty: a moved-from one holds a
+ * moved-from `T`, so moving must not throw.
+ */
+template<typename T, size_t Size, size_t Align = alignof(std::max_align_t)>
+class FastPimpl
+{
+    alignas(Align) std::byte storage[Size];
+
+    template<size_t ActualSize, size_t ActualAlign>
+    static constexpr void validate() noexcept
+    {
+        static_assert(ActualSize <= Size, "FastPimpl: Size is smaller than sizeof(T)");
+        static_assert(Align % ActualAlign == 0, "FastPimpl: Align is not a multiple of alignof(T)");
+        static_assert(std::is_nothrow_move_constructible_v<T> && std::is_nothrow_move_assignable_v<T>,
+                      "FastPimpl: moving T must not throw");
+    }
+
+public:
+    template<typename... Args>
+        requires std::is_constructible_v<T, Args...>
+    explicit FastPimpl(Args&&... args)
+    {
+        std::construct_at(get(), std::forward<Args>(args)...);
+    }
+
+    FastPimpl(const FastPimpl& other) : FastPimpl(*other) {}
+    FastPimpl(FastPimpl&& other) noexcept : FastPimpl(std::move(*other)) {}
+
+    FastPimpl& operator=(const FastPimpl& other)
+    {
+        **this = *other;
+        return *this;
+    }
+
+    FastPimpl& operator=(FastPimpl&& other) noexcept
+    {
+        **this = std::move(*other);
+        return *this;
+    }
+
+    ~FastPimpl() noexcept
+    {
+        validate<sizeof(T), alignof(T)>();
+        std::destroy_at(get());
+    }
+
+    T*       get()       noexcept { return std::launder(reinterpret_cast<T*>(storage)); }
+    const T* get() const noexcept { return std::launder(reinterpret_cast<const T*>(storage)); }
+
+    T&       operator*()        noexcept { return *get(); }
+    const T& operator*()  const noexcept { return *get(); }
+    T*       operator->()       noexcept { return get(); }
+    const T* operator->() const noexcept { return get(); }
+};
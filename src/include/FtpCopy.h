@@ -0,0 +1,40 @@
+#pragma once
+#include "ThreadPool.h"
+#include <cstddef> // size_t, byte
+#include <istream>
+#include <ostream>
+#include <span>
+
+namespace kw
+{
+    /**
+     * @brief The "fake download" of `size` bytes from `inFile`, shared by the
+     *        FTP example classes; reports progress in percent
+     */
+    template<typename OnProgress>
+    void copyWithProgress(std::istream& inFile, std::ostream& outFile, size_t size, OnProgress& onProgress)
+    {
+        int prevProgress = -1;
+        char localBuf[128]; // artificially small buffer for this fake example
+        // pool workers bring their own copy buffer, allocated on their NUMA node
+        std::span<std::byte> workerBuf = ThreadPool::workerBuffer();
+        char* buf = workerBuf.empty() ? localBuf : reinterpret_cast<char*>(workerBuf.data());
+        std::streamsize bufSize = workerBuf.empty() ? sizeof(localBuf) : static_cast<std::streamsize>(workerBuf.size());
+        for (size_t i = 0; i < size; )
+        {
+            inFile.read(buf, bufSize);
+            size_t bytesRead = inFile.gcount();
+            if (bytesRead == 0) break; // the file got shorter
+            outFile.write(buf, bytesRead);
+
+            i += bytesRead;
+
+            // report progress to the UI
+            if (int progress = static_cast<int>((i * 100) / size); prevProgress != progress)
+            {
+                prevProgress = progress;
+                onProgress(progress); // the UI will handle synchronization
+            }
+        }
+    }
+}
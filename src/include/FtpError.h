@@ -0,0 +1,72 @@
+#pragma once
+#include "Expected.h"
+
+#include <string>
+#include <system_error>
+#include <type_traits>
+
+namespace kw
+{
+    /** @brief FTP failures reported by value, see the `try*` FTP methods */
+    enum class FtpError : int
+    {
+        PathNotFound = 1,
+        NoMatch,
+        NotAFile,
+        DownloadFailed,
+        TempFileFailed,
+    };
+
+    class FtpErrorCategory final : public std::error_category
+    {
+    public:
+        const char* name() const noexcept override { return "ftp"; }
+
+        std::string message(int e) const override
+        {
+            switch (static_cast<FtpError>(e))
+            {
+            case FtpError::PathNotFound:   return "FTP remote path does not exist";
+            case FtpError::NoMatch:        return "FTP no files matched the search pattern";
+            case FtpError::NotAFile:       return "FTP download failed, not a file";
+            case FtpError::DownloadFailed: return "FTP download request failed";
+            case FtpError::TempFileFailed: return "FTP failed to create temp file";
+            }
+            return "FTP unknown error";
+        }
+    };
+
+    inline const std::error_category& ftpCategory() noexcept
+    {
+        static const FtpErrorCategory category;
+        return category;
+    }
+
+    inline std::error_code make_error_code(FtpError e) noexcept
+    {
+        return { static_cast<int>(e), ftpCategory() };
+    }
+
+    template<typename T>
+    using FtpResult = Expected<T, FtpError>;
+
+    /**
+     * @brief Bridges the value-based error channel to the throwing API
+     * @param context Path the failed operation worked on, added in front of the message unless empty
+     * @throws std::system_error (a std::runtime_error) with the FtpError code
+     */
+    template<typename T>
+    T valueOrThrow(FtpResult<T>&& result, const std::string& context)
+    {
+        if (!result)
+        {
+            if (context.empty())
+                throw std::system_error{ make_error_code(result.error()) };
+            throw std::system_error{ make_error_code(result.error()), context };
+        }
+        return std::move(*result);
+    }
+}
+
+template<>
+struct std::is_error_code_enum<kw::FtpError> : std::true_type {};
@@ -1,5 +1,9 @@
 #include "log.h"
 #include "RemoteDirEntry.h"
+#include "FtpError.h"
+#include "FtpLatency.h"
+#include "FtpCopy.h"
+#include "AdaptiveAsync.h"
 #include <vector>
 #include <string>
 #include <string_view>
@@ -19,10 +23,12 @@ namespace kw
         //       this complicates the implementation
         std::vector<RemoteDirEntry> listed;
         std::string listedPath;
+        ThreadPool& pool;
 
     public:
 
-        FTPExampleAsync() noexcept = default;
+        /** @param pool Runs the file matching once it is worth a worker, must outlive this */
+        explicit FTPExampleAsync(ThreadPool& pool) noexcept : pool{pool} {}
 
         /** @returns List of remote dir entries from the last `listFiles` call, for the UI */
         const std::vector<RemoteDirEntry>& getListed() const noexcept { return listed; }
@@ -48,16 +54,48 @@ namespace kw
             auto filesF = std::async(std::launch::async,
                 [this, remotePath]() { return listFiles(remotePath); });
 
-            auto matchF = std::async(std::launch::async,
-                [this, predicate = std::move(predicate)] (decltype(filesF)&& files) {
-                    return findMatchingFile(files.get(), std::move(predicate));
+            // matching a short list is too small for a thread of its own,
+            // adaptive_async runs it inline once it has seen how long it takes
+            auto tempPathF = std::async(std::launch::async,
+                [this, remotePath, predicate = std::move(predicate), onProgress = std::move(onProgress)]
+                (decltype(filesF)&& files) mutable {
+                    auto list = files.get();
+                    auto match = adaptive_async(pool, [&list, &predicate, &remotePath] {
+                        return findMatchingFile(list, std::move(predicate), remotePath);
+                    });
+                    return downloadFile(match.get(), std::move(onProgress));
                 }, std::move(filesF)
             );
 
+            return tempPathF;
+        }
+
+        /**
+         * @brief Same as `downloadFirstMatch`, but failures are returned
+         *        by value instead of being set as future exceptions
+         * @returns Future of the local temp path of the downloaded file or the FTP error
+         */
+        auto tryDownloadFirstMatch(const std::string& remotePath,
+                                   std::function<bool(std::string_view)> predicate,
+                                   std::function<void(int)> onProgress)
+        {
+            // assuming "this" will outlive the future
+
+            auto filesF = std::async(std::launch::async,
+                [this, remotePath]() { return tryListFiles(remotePath); });
+
             auto tempPathF = std::async(std::launch::async,
-                [this, onProgress = std::move(onProgress)](decltype(matchF)&& match) {
-                    return downloadFile(match.get(), std::move(onProgress));
-                }, std::move(matchF)
+                [this, predicate = std::move(predicate), onProgress = std::move(onProgress)]
+                (decltype(filesF)&& files) mutable -> FtpResult<std::string> {
+                    auto list = files.get();
+                    if (!list) return Unexpected{list.error()};
+                    auto match = adaptive_async(pool, [&list, &predicate] {
+                        return tryFindMatchingFile(*list, std::move(predicate));
+                    });
+                    auto entry = match.get();
+                    if (!entry) return Unexpected{entry.error()};
+                    return tryDownloadFile(*entry, std::move(onProgress));
+                }, std::move(filesF)
             );
 
             return tempPathF;
@@ -67,15 +105,45 @@ namespace kw
 
         std::vector<RemoteDirEntry> listFiles(const std::string& remotePath)
         {
+            return valueOrThrow(tryListFiles(remotePath), remotePath);
+        }
+
+        static RemoteDirEntry findMatchingFile(const std::vector<RemoteDirEntry>& list,
+                                               std::function<bool(std::string_view)> predicate,
+                                               const std::string& remotePath)
+        {
+            return valueOrThrow(tryFindMatchingFile(list, std::move(predicate)), remotePath);
+        }
+
+        std::string downloadFile(const RemoteDirEntry& remoteFile,
+                                 std::function<void(int)> onProgress)
+        {
+            auto tempPath = tryDownloadFile(remoteFile, std::move(onProgress));
+            // the temp file is the one that could not be opened, not the remote one
+            if (!tempPath && tempPath.error() == FtpError::TempFileFailed)
+                return valueOrThrow(std::move(tempPath), tempPathFor(remoteFile));
+            return valueOrThrow(std::move(tempPath), remoteFile.remotePath);
+        }
+
+        /** @returns Local temp path a download of `remoteFile` goes to */
+        static std::string tempPathFor(const RemoteDirEntry& remoteFile)
+        {
+            return (fs::temp_directory_path() / fs::path{remoteFile.remotePath}.filename()).string();
+        }
+
+        FtpResult<std::vector<RemoteDirEntry>> tryListFiles(const std::string& remotePath)
+        {
+            auto timer = ftpTimer(&FtpLatency::list);
             LogInfo("LIST %s", remotePath.c_str());
 
-            if (!fs::exists(remotePath)) // failures are handled by exceptions
-                throw std::runtime_error{"FTP remote path does not exist: " + remotePath};
+            if (!fs::exists(remotePath))
+                return Unexpected{FtpError::PathNotFound};
 
             std::vector<RemoteDirEntry> list;
             for (const fs::directory_entry& dirEntry : fs::directory_iterator{remotePath})
             {
-                list.emplace_back(dirEntry.path().string(), dirEntry.file_size(), dirEntry.is_regular_file());
+                bool isFile = dirEntry.is_regular_file();
+                list.emplace_back(dirEntry.path().string(), isFile ? dirEntry.file_size() : 0, isFile);
                 const RemoteDirEntry& e = list.back();
                 if (e.isFile) LogInfo("  file %s (%zu KB)", e.path(), e.size);
                 else          LogInfo("  dir  %s", e.path());
@@ -86,49 +154,35 @@ namespace kw
             return list;
         }
 
-        static RemoteDirEntry findMatchingFile(const std::vector<RemoteDirEntry>& list,
-                                               std::function<bool(std::string_view)> predicate)
+        static FtpResult<RemoteDirEntry> tryFindMatchingFile(const std::vector<RemoteDirEntry>& list,
+                                                             std::function<bool(std::string_view)> predicate)
         {
+            auto timer = ftpTimer(&FtpLatency::match);
             for (auto& e : list)
                 if (e.isFile && predicate(e.remotePath))
                     return e;
-            throw std::runtime_error{"FTP no files matched the search pattern"};
+            return Unexpected{FtpError::NoMatch};
         }
 
-        std::string downloadFile(const RemoteDirEntry& remoteFile,
-                                 std::function<void(int)> onProgress)
+        FtpResult<std::string> tryDownloadFile(const RemoteDirEntry& remoteFile,
+                                               std::function<void(int)> onProgress)
         {
+            auto timer = ftpTimer(&FtpLatency::download);
             LogInfo("DOWNLOAD %s (%zu KB)", remoteFile.path(), remoteFile.size / 1024);
             if (!remoteFile.isFile)
-                throw std::runtime_error{"FTP download failed, not a file: " + remoteFile.remotePath};
+                return Unexpected{FtpError::NotAFile};
             
             std::ifstream inFile { remoteFile.remotePath, std::ios::binary };
             if (!inFile)
-                throw std::runtime_error{"FTP download request failed: " + remoteFile.remotePath};
+                return Unexpected{FtpError::DownloadFailed};
 
-            std::string tempPath = (fs::temp_directory_path() / fs::path{remoteFile.remotePath}.filename()).string();
+            std::string tempPath = tempPathFor(remoteFile);
             std::ofstream outFile { tempPath, std::ios::binary };
             if (!outFile)
-                throw std::runtime_error{"FTP failed to create temp file at: " + tempPath};
+                return Unexpected{FtpError::TempFileFailed};
             
             // perform a "fake download"
-            int prevProgress = -1;
-            char buf[128]; // artificially small buffer for this fake example
-            for (size_t i = 0; i < remoteFile.size; ++i)
-            {
-                inFile.read(buf, sizeof(buf));
-                size_t bytesRead = inFile.gcount();
-                outFile.write(buf, bytesRead);
-
-                i += bytesRead;
-
-                // report progress to the UI
-                if (int progress = static_cast<int>((i * 100) / remoteFile.size); prevProgress != progress)
-                {
-                    prevProgress = progress;
-                    onProgress(progress); // the UI will handle synchronization
-                }
-            }
+            copyWithProgress(inFile, outFile, remoteFile.size, onProgress);
             return tempPath;
         }
     };
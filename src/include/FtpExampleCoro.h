@@ -1,6 +1,13 @@
 #include "log.h"
 #include "RemoteDirEntry.h"
+#include "FtpError.h"
+#include "FtpLatency.h"
+#include "FtpCopy.h"
 #include "future_coro.h"
+#include "Task.h"
+#include "SyncWaitTask.h"
+#include "Channel.h"
+#include "ScheduleOn.h"
 #include <vector>
 #include <string>
 #include <string_view>
@@ -9,6 +16,8 @@
 #include <filesystem>
 #include <fstream>
 #include <thread>
+#include <future>
+#include <exception>
 
 namespace kw
 {
@@ -40,30 +49,146 @@ namespace kw
          * 
          * TODO: return an async object instead of blocking here
          */
-        std::future<std::string> downloadFirstMatch(const std::string& remotePath, 
+        std::future<std::string> downloadFirstMatch(std::string remotePath,
                                        std::function<bool(std::string_view)> predicate,
                                        std::function<void(int)> onProgress)
         {
             LogInfo("Current thread ID on start: %llu", std::this_thread::get_id());
             auto files = co_await listFiles(remotePath);
-            auto match = co_await findMatchingFile(files, std::move(predicate));
+            auto match = co_await findMatchingFile(files, std::move(predicate), remotePath);
             co_return co_await downloadFile(match, std::move(onProgress));
         }
 
+        /**
+         * @brief Same as `downloadFirstMatch`, but failures are returned by value:
+         *        an error propagates through the awaiting coroutines without rethrows
+         * @returns Task with the local temp path of the downloaded file or the FTP error
+         */
+        Task<FtpResult<std::string>> tryDownloadFirstMatch(std::string remotePath,
+                                       std::function<bool(std::string_view)> predicate,
+                                       std::function<void(int)> onProgress)
+        {
+            auto files = co_await tryListFiles(remotePath);
+            if (!files) co_return Unexpected{files.error()};
+
+            auto match = co_await tryFindMatchingFile(*files, std::move(predicate));
+            if (!match) co_return Unexpected{match.error()};
+
+            co_return co_await tryDownloadFile(*match, std::move(onProgress));
+        }
+
+        /**
+         * @brief Same as `tryDownloadFirstMatch`, but the blocking LIST and file I/O
+         *        run on `io` and onProgress is delivered on `ui`, so the callback
+         *        needs no synchronization of its own
+         * @param io Executor for the blocking work, e.g. an I/O pool
+         * @param ui Executor the progress and the result are delivered on, e.g. the UI RunLoop
+         * @returns Task that completes on `ui`, after all progress reports
+         *          (when `ui` runs its work in order)
+         */
+        template<Executor IoExecutor, Executor UiExecutor>
+        Task<FtpResult<std::string>> tryDownloadFirstMatch(IoExecutor& io, UiExecutor& ui,
+                                       std::string remotePath,
+                                       std::function<bool(std::string_view)> predicate,
+                                       std::function<void(int)> onProgress)
+        {
+            auto progressOnUi = [&ui, onProgress = std::move(onProgress)](int progress) {
+                spawn_on(ui, [onProgress, progress] { onProgress(progress); });
+            };
+            co_return co_await resume_on(ui, schedule_on(io,
+                tryDownloadFirstMatch(std::move(remotePath), std::move(predicate), std::move(progressOnUi))));
+        }
+
+        /**
+         * @brief Downloads every file that matches the predicate in the given remote dirs.
+         *        LIST, matching and DOWNLOAD run as pipeline stages on their own threads,
+         *        connected by bounded channels: listing the next dir overlaps with
+         *        downloading from the current one, and a slow stage throttles the others
+         * @param remotePaths Remote paths to fetch LIST of files from
+         * @param predicate Files filter to select the files
+         * @param onProgress Progress report callback for the UI progress bar
+         * @param capacity Max number of entries buffered between two stages
+         * @returns Local temp paths of the downloaded files, in LIST order
+         */
+        std::future<std::vector<std::string>> downloadAllMatches(std::vector<std::string> remotePaths,
+                                       std::function<bool(std::string_view)> predicate,
+                                       std::function<void(int)> onProgress,
+                                       size_t capacity = 16)
+        {
+            // assuming "this" will outlive the future
+            return std::async(std::launch::async,
+                [this, remotePaths = std::move(remotePaths), predicate = std::move(predicate),
+                 onProgress = std::move(onProgress), capacity] {
+                    Channel<RemoteDirEntry> entries {capacity};
+                    Channel<RemoteDirEntry> matches {capacity};
+                    std::exception_ptr listError, matchError;
+
+                    std::thread lister { [&] {
+                        try { syncWait(listStage(remotePaths, entries)); }
+                        catch (...) { listError = std::current_exception(); }
+                    }};
+                    std::thread matcher { [&] {
+                        try { syncWait(matchStage(entries, matches, predicate)); }
+                        catch (...) { matchError = std::current_exception(); }
+                    }};
+
+                    std::exception_ptr downloadError;
+                    std::vector<std::string> tempPaths;
+                    try { tempPaths = syncWait(downloadStage(matches, onProgress)); }
+                    catch (...) { downloadError = std::current_exception(); }
+
+                    lister.join();
+                    matcher.join();
+                    for (auto& error : { listError, matchError, downloadError })
+                        if (error) std::rethrow_exception(error);
+                    return tempPaths;
+                });
+        }
+
     private:
 
         std::future<std::vector<RemoteDirEntry>> listFiles(const std::string& remotePath)
         {
+            co_return valueOrThrow(co_await tryListFiles(remotePath), remotePath);
+        }
+
+        static std::future<RemoteDirEntry> findMatchingFile(const std::vector<RemoteDirEntry>& list,
+                                               std::function<bool(std::string_view)> predicate,
+                                               const std::string& remotePath)
+        {
+            co_return valueOrThrow(co_await tryFindMatchingFile(list, std::move(predicate)), remotePath);
+        }
+
+        std::future<std::string> downloadFile(const RemoteDirEntry& remoteFile,
+                                 std::function<void(int)> onProgress)
+        {
+            auto tempPath = co_await tryDownloadFile(remoteFile, std::move(onProgress));
+            // the temp file is the one that could not be opened, not the remote one
+            if (!tempPath && tempPath.error() == FtpError::TempFileFailed)
+                co_return valueOrThrow(std::move(tempPath), tempPathFor(remoteFile));
+            co_return valueOrThrow(std::move(tempPath), remoteFile.remotePath);
+        }
+
+        /** @returns Local temp path a download of `remoteFile` goes to */
+        static std::string tempPathFor(const RemoteDirEntry& remoteFile)
+        {
+            return (fs::temp_directory_path() / fs::path{remoteFile.remotePath}.filename()).string();
+        }
+
+        Task<FtpResult<std::vector<RemoteDirEntry>>> tryListFiles(const std::string& remotePath)
+        {
+            auto timer = ftpTimer(&FtpLatency::list);
             LogInfo("listFiles: Current thread ID: %llu", std::this_thread::get_id());
             LogInfo("LIST %s", remotePath.c_str());
             
-            if (!fs::exists(remotePath)) // failures are handled by exceptions
-                throw std::runtime_error{"FTP remote path does not exist: " + remotePath};
+            if (!fs::exists(remotePath))
+                co_return Unexpected{FtpError::PathNotFound};
 
             std::vector<RemoteDirEntry> list;
             for (const fs::directory_entry& dirEntry : fs::directory_iterator{remotePath})
             {
-                list.emplace_back(dirEntry.path().string(), dirEntry.file_size(), dirEntry.is_regular_file());
+                bool isFile = dirEntry.is_regular_file();
+                list.emplace_back(dirEntry.path().string(), isFile ? dirEntry.file_size() : 0, isFile);
                 const RemoteDirEntry& e = list.back();
                 if (e.isFile) LogInfo("  file %s (%zu KB)", e.path(), e.size);
                 else          LogInfo("  dir  %s", e.path());
@@ -74,51 +199,94 @@ namespace kw
             co_return list;
         }
 
-        static std::future<RemoteDirEntry> findMatchingFile(const std::vector<RemoteDirEntry>& list,
-                                               std::function<bool(std::string_view)> predicate)
+        static Task<FtpResult<RemoteDirEntry>> tryFindMatchingFile(const std::vector<RemoteDirEntry>& list,
+                                                                   std::function<bool(std::string_view)> predicate)
         {
+            auto timer = ftpTimer(&FtpLatency::match);
             LogInfo("findMatchingFile: Current thread ID: %llu", std::this_thread::get_id());
             for (auto& e : list)
                 if (e.isFile && predicate(e.remotePath))
                     co_return e;
-            throw std::runtime_error{"FTP no files matched the search pattern"};
+            co_return Unexpected{FtpError::NoMatch};
         }
 
-        std::future<std::string> downloadFile(const RemoteDirEntry& remoteFile,
-                                 std::function<void(int)> onProgress)
+        // Pipeline stages close both of their channels when they stop,
+        // so a failure anywhere cancels the stages before and after it
+
+        Task<> listStage(const std::vector<std::string>& remotePaths, Channel<RemoteDirEntry>& out)
+        {
+            try
+            {
+                for (const auto& remotePath : remotePaths)
+                    for (auto& e : co_await listFiles(remotePath))
+                        if (!co_await out.send(std::move(e)))
+                            co_return; // closed by the next stage, already cleaned up
+            }
+            catch (...)
+            {
+                out.close();
+                throw;
+            }
+            out.close();
+        }
+
+        static Task<> matchStage(Channel<RemoteDirEntry>& in, Channel<RemoteDirEntry>& out,
+                                 const std::function<bool(std::string_view)>& predicate)
         {
+            try
+            {
+                while (auto e = co_await in.receive())
+                    if (e->isFile && predicate(e->remotePath))
+                        if (!co_await out.send(std::move(*e)))
+                            break;
+            }
+            catch (...)
+            {
+                in.close();
+                out.close();
+                throw;
+            }
+            in.close();
+            out.close();
+        }
+
+        Task<std::vector<std::string>> downloadStage(Channel<RemoteDirEntry>& in,
+                                                     const std::function<void(int)>& onProgress)
+        {
+            std::vector<std::string> tempPaths;
+            try
+            {
+                while (auto match = co_await in.receive())
+                    tempPaths.push_back(co_await downloadFile(*match, onProgress));
+            }
+            catch (...)
+            {
+                in.close();
+                throw;
+            }
+            co_return tempPaths;
+        }
+
+        Task<FtpResult<std::string>> tryDownloadFile(const RemoteDirEntry& remoteFile,
+                                                     std::function<void(int)> onProgress)
+        {
+            auto timer = ftpTimer(&FtpLatency::download);
             LogInfo("downloadFile: Current thread ID: %llu", std::this_thread::get_id());
             LogInfo("DOWNLOAD %s (%zu KB)", remoteFile.path(), remoteFile.size / 1024);
             if (!remoteFile.isFile)
-                throw std::runtime_error{"FTP download failed, not a file: " + remoteFile.remotePath};
+                co_return Unexpected{FtpError::NotAFile};
             
             std::ifstream inFile { remoteFile.remotePath, std::ios::binary };
             if (!inFile)
-                throw std::runtime_error{"FTP download request failed: " + remoteFile.remotePath};
+                co_return Unexpected{FtpError::DownloadFailed};
 
-            std::string tempPath = (fs::temp_directory_path() / fs::path{remoteFile.remotePath}.filename()).string();
+            std::string tempPath = tempPathFor(remoteFile);
             std::ofstream outFile { tempPath, std::ios::binary };
             if (!outFile)
-                throw std::runtime_error{"FTP failed to create temp file at: " + tempPath};
+                co_return Unexpected{FtpError::TempFileFailed};
             
             // perform a "fake download"
-            int prevProgress = -1;
-            char buf[128]; // artificially small buffer for this fake example
-            for (size_t i = 0; i < remoteFile.size; ++i)
-            {
-                inFile.read(buf, sizeof(buf));
-                size_t bytesRead = inFile.gcount();
-                outFile.write(buf, bytesRead);
-
-                i += bytesRead;
-
-                // report progress to the UI
-                if (int progress = static_cast<int>((i * 100) / remoteFile.size); prevProgress != progress)
-                {
-                    prevProgress = progress;
-                    onProgress(progress); // the UI will handle synchronization
-                }
-            }
+            copyWithProgress(inFile, outFile, remoteFile.size, onProgress);
             co_return tempPath;
         }
     };
@@ -0,0 +1,138 @@
+#pragma once
+#include "log.h"
+#include "RemoteDirEntry.h"
+#include "FtpError.h"
+#include "Task.h"
+#include "VirtualTimeScheduler.h"
+#include <vector>
+#include <map>
+#include <string>
+#include <string_view>
+#include <cstddef> // size_t
+#include <functional> // std::function
+#include <filesystem>
+
+namespace kw
+{
+    namespace fs = std::filesystem;
+
+    /**
+     * @brief Same flow as FTPExampleCoro::tryDownloadFirstMatch, but against a simulated
+     *        remote: every LIST and DOWNLOAD waits for an injected latency on a
+     *        VirtualTimeScheduler instead of doing I/O, so latency scenarios replay exactly
+     */
+    class FTPExampleSim
+    {
+    public:
+        using duration = VirtualTimeScheduler::duration;
+
+        /** @brief Latency of the simulated remote, in virtual time */
+        struct LatencyModel
+        {
+            duration list {0};          // per LIST request
+            duration firstByte {0};     // per DOWNLOAD request, before the first byte arrives
+            size_t bytesPerSecond = 0;  // transfer rate of a single download, 0 means instant
+            std::function<duration(const RemoteDirEntry&)> extra; // injected per-file latency
+        };
+
+    private:
+        VirtualTimeScheduler& scheduler;
+        LatencyModel latency;
+        std::map<std::string, std::vector<RemoteDirEntry>> remoteDirs;
+
+        // spec: last LIST result needs to be kept around for the UI
+        //       this complicates the implementation
+        std::vector<RemoteDirEntry> listed;
+        std::string listedPath;
+
+        static constexpr int PROGRESS_STEPS = 10;
+
+    public:
+
+        FTPExampleSim(VirtualTimeScheduler& scheduler, LatencyModel latency) noexcept
+        : scheduler {scheduler}, latency {std::move(latency)}
+        {}
+
+        /** @brief Adds a file to the simulated remote, its path is "<remoteDir>/<name>" */
+        void addRemoteFile(const std::string& remoteDir, const std::string& name, size_t size)
+        {
+            remoteDirs[remoteDir].emplace_back((fs::path{remoteDir} / name).string(), size, true);
+        }
+
+        /** @returns List of remote dir entries from the last `listFiles` call, for the UI */
+        const std::vector<RemoteDirEntry>& getListed() const noexcept { return listed; }
+
+        /** @returns Listed remote path name from the last `listFiles` call, for the UI */
+        const std::string& getListedPath() const noexcept { return listedPath; }
+
+        /**
+         * @brief Downloads the first file that matches the predicate
+         * @param remotePath Remote path to fetch LIST of files from
+         * @param predicate Files filter to select the file
+         * @param onProgress Progress report callback for the UI progress bar
+         * @returns Task with the local temp path of the downloaded file (nothing is
+         *          written there) or the FTP error
+         */
+        Task<FtpResult<std::string>> tryDownloadFirstMatch(std::string remotePath,
+                                       std::function<bool(std::string_view)> predicate,
+                                       std::function<void(int)> onProgress)
+        {
+            auto files = co_await tryListFiles(remotePath);
+            if (!files) co_return Unexpected{files.error()};
+
+            auto match = findMatchingFile(*files, predicate);
+            if (!match) co_return Unexpected{match.error()};
+
+            co_return co_await tryDownloadFile(*match, std::move(onProgress));
+        }
+
+        Task<FtpResult<std::vector<RemoteDirEntry>>> tryListFiles(const std::string& remotePath)
+        {
+            LogInfo("LIST %s", remotePath.c_str());
+            co_await scheduler.sleepFor(latency.list);
+
+            auto dir = remoteDirs.find(remotePath);
+            if (dir == remoteDirs.end())
+                co_return Unexpected{FtpError::PathNotFound};
+
+            listed = dir->second; // make a copy for the UI to use later
+            listedPath = remotePath;
+            co_return dir->second;
+        }
+
+        Task<FtpResult<std::string>> tryDownloadFile(RemoteDirEntry remoteFile,
+                                                     std::function<void(int)> onProgress)
+        {
+            LogInfo("DOWNLOAD %s (%zu KB)", remoteFile.path(), remoteFile.size / 1024);
+            if (!remoteFile.isFile)
+                co_return Unexpected{FtpError::NotAFile};
+
+            duration wait = latency.firstByte;
+            if (latency.extra) wait += latency.extra(remoteFile);
+            co_await scheduler.sleepFor(wait);
+
+            duration transfer {0};
+            if (latency.bytesPerSecond)
+                transfer = duration{ static_cast<duration::rep>(remoteFile.size * 1'000'000'000ull / latency.bytesPerSecond) };
+
+            // report progress to the UI as the "bytes" arrive
+            for (int step = 1; step <= PROGRESS_STEPS; ++step)
+            {
+                co_await scheduler.sleepFor(transfer * step / PROGRESS_STEPS - transfer * (step - 1) / PROGRESS_STEPS);
+                onProgress(step * 100 / PROGRESS_STEPS);
+            }
+            co_return (fs::temp_directory_path() / fs::path{remoteFile.remotePath}.filename()).string();
+        }
+
+    private:
+
+        static FtpResult<RemoteDirEntry> findMatchingFile(const std::vector<RemoteDirEntry>& list,
+                                                          const std::function<bool(std::string_view)>& predicate)
+        {
+            for (auto& e : list)
+                if (e.isFile && predicate(e.remotePath))
+                    return e;
+            return Unexpected{FtpError::NoMatch};
+        }
+    };
+}
@@ -1,12 +1,19 @@
 #include "log.h"
 #include "RemoteDirEntry.h"
+#include "FtpError.h"
+#include "FtpLatency.h"
+#include "FtpCopy.h"
 #include <vector>
 #include <string>
 #include <string_view>
+#include <chrono>
 #include <cstddef> // size_t
 #include <functional> // std::function
 #include <filesystem>
 #include <fstream>
+#include <ios>
+#include <system_error>
+#include <utility>
 
 namespace kw
 {
@@ -19,8 +26,19 @@ namespace kw
         std::vector<RemoteDirEntry> listed;
         std::string listedPath;
 
+        // reused by tryDownloadFirstMatchCached(), see there
+        fs::path listedDir;
+        fs::file_time_type listedWriteTime {};
+        bool listedIsCached = false;
+        std::string tempDir;
+        std::string tempPath;
+        std::vector<char> streamBuffers;
+
     public:
 
+        /** @brief Coarsest dir write time step a cached LIST allows for (FAT has 2 s) */
+        static constexpr std::chrono::seconds TIMESTAMP_GRANULARITY {2};
+
         FTPExampleSync() noexcept = default;
 
         /** @returns List of remote dir entries from the last `listFiles` call, for the UI */
@@ -46,7 +64,7 @@ namespace kw
             auto files = listFiles(remotePath);
 
             // Step 2. Find the first matching file. TODO: make async
-            RemoteDirEntry match = findMatchingFile(files, std::move(predicate));
+            RemoteDirEntry match = findMatchingFile(files, std::move(predicate), remotePath);
 
             // Step 3. Download the file. TODO: make async
             std::string tempPath = downloadFile(match, std::move(onProgress));
@@ -54,19 +72,155 @@ namespace kw
             return tempPath;
         }
 
+        /**
+         * @brief Same as `downloadFirstMatch`, but failures are returned
+         *        by value instead of being thrown
+         * @returns Local temp path of the downloaded file or the FTP error
+         */
+        FtpResult<std::string> tryDownloadFirstMatch(const std::string& remotePath,
+                                       std::function<bool(std::string_view)> predicate,
+                                       std::function<void(int)> onProgress)
+        {
+            auto files = tryListFiles(remotePath);
+            if (!files) return Unexpected{files.error()};
+
+            auto match = tryFindMatchingFile(*files, std::move(predicate));
+            if (!match) return Unexpected{match.error()};
+
+            return tryDownloadFile(*match, std::move(onProgress));
+        }
+
+        /**
+         * @brief Same as `tryDownloadFirstMatch`, for calling it again and again
+         *        on the same remote dir: once the buffers of this instance have
+         *        grown to fit, a call does not allocate at all.
+         *
+         * The LIST result is reused as long as the write time of `remotePath`
+         * (which changes when entries are added, removed or renamed) stays the
+         * same. Like git's "racy" index entries, a LIST made less than
+         * TIMESTAMP_GRANULARITY after that write time is not reused: a change
+         * in the same time step would not move it. The size of the match is
+         * read from the opened file. The match
+         * is not copied, the streams use buffers of this instance and the temp
+         * path is built in place. `predicate` and `onProgress` are called
+         * directly instead of through std::function.
+         * @returns Local temp path of the downloaded file, valid until the next call
+         */
+        template<typename Predicate, typename OnProgress>
+        FtpResult<std::string_view> tryDownloadFirstMatchCached(std::string_view remotePath,
+                                                                Predicate&& predicate,
+                                                                OnProgress&& onProgress)
+        {
+            if (!isListingCurrent(remotePath))
+            {
+                listedIsCached = false;
+                listedDir = remotePath;
+                std::error_code ec;
+                fs::file_time_type writeTime = fs::last_write_time(listedDir, ec); // before LIST, changes during it show up next time
+                auto files = tryListFiles(std::string{remotePath});
+                if (!files) return Unexpected{files.error()};
+                listedWriteTime = writeTime;
+                listedIsCached = !ec && fs::file_time_type::clock::now() - writeTime >= TIMESTAMP_GRANULARITY;
+            }
+
+            const RemoteDirEntry* match = nullptr;
+            {
+                auto timer = ftpTimer(&FtpLatency::match);
+                for (const RemoteDirEntry& e : listed)
+                    if (e.isFile && predicate(std::string_view{e.remotePath}))
+                    {
+                        match = &e;
+                        break;
+                    }
+            }
+            if (!match) return Unexpected{FtpError::NoMatch};
+
+            auto timer = ftpTimer(&FtpLatency::download);
+            LogInfo("DOWNLOAD %s", match->path());
+            const size_t bufferSize = 4096;
+            if (streamBuffers.empty()) streamBuffers.resize(2 * bufferSize);
+
+            // a filebuf allocates its buffer on open() unless it is given one before
+            std::ifstream inFile;
+            inFile.rdbuf()->pubsetbuf(streamBuffers.data(), bufferSize);
+            inFile.open(match->remotePath, std::ios::binary);
+            if (!inFile)
+                return Unexpected{FtpError::DownloadFailed};
+            std::streamoff end = inFile.seekg(0, std::ios::end).tellg();
+            if (end < 0 || !inFile.seekg(0))
+                return Unexpected{FtpError::DownloadFailed};
+            size_t size = static_cast<size_t>(end);
+
+            if (tempDir.empty()) tempDir = fs::temp_directory_path().string();
+            constexpr std::string_view separators = fs::path::preferred_separator == '/' ? "/" : "/\\";
+            std::string_view name = match->remotePath;
+            name.remove_prefix(name.find_last_of(separators) + 1); // npos + 1 == 0
+            tempPath.assign(tempDir);
+            if (!tempPath.empty() && separators.find(tempPath.back()) == std::string_view::npos)
+                tempPath += static_cast<char>(fs::path::preferred_separator);
+            tempPath += name;
+
+            std::ofstream outFile;
+            outFile.rdbuf()->pubsetbuf(streamBuffers.data() + bufferSize, bufferSize);
+            outFile.open(tempPath, std::ios::binary);
+            if (!outFile)
+                return Unexpected{FtpError::TempFileFailed};
+
+            copyWithProgress(inFile, outFile, size, onProgress);
+            return std::string_view{tempPath};
+        }
+
     private:
 
+        /** @returns Whether `listed` is the LIST of `remotePath` and the dir did not change since */
+        bool isListingCurrent(std::string_view remotePath) const noexcept
+        {
+            if (!listedIsCached || remotePath != listedPath) return false;
+            std::error_code ec;
+            return fs::last_write_time(listedDir, ec) == listedWriteTime && !ec;
+        }
+
         std::vector<RemoteDirEntry> listFiles(const std::string& remotePath)
         {
+            return valueOrThrow(tryListFiles(remotePath), remotePath);
+        }
+
+        static RemoteDirEntry findMatchingFile(const std::vector<RemoteDirEntry>& list,
+                                               std::function<bool(std::string_view)> predicate,
+                                               const std::string& remotePath)
+        {
+            return valueOrThrow(tryFindMatchingFile(list, std::move(predicate)), remotePath);
+        }
+
+        std::string downloadFile(const RemoteDirEntry& remoteFile,
+                                 std::function<void(int)> onProgress)
+        {
+            auto tempPath = tryDownloadFile(remoteFile, std::move(onProgress));
+            // the temp file is the one that could not be opened, not the remote one
+            if (!tempPath && tempPath.error() == FtpError::TempFileFailed)
+                return valueOrThrow(std::move(tempPath), tempPathFor(remoteFile));
+            return valueOrThrow(std::move(tempPath), remoteFile.remotePath);
+        }
+
+        /** @returns Local temp path a download of `remoteFile` goes to */
+        static std::string tempPathFor(const RemoteDirEntry& remoteFile)
+        {
+            return (fs::temp_directory_path() / fs::path{remoteFile.remotePath}.filename()).string();
+        }
+
+        FtpResult<std::vector<RemoteDirEntry>> tryListFiles(const std::string& remotePath)
+        {
+            auto timer = ftpTimer(&FtpLatency::list);
             LogInfo("LIST %s", remotePath.c_str());
 
-            if (!fs::exists(remotePath)) // failures are handled by exceptions
-                throw std::runtime_error{"FTP remote path does not exist: " + remotePath};
+            if (!fs::exists(remotePath))
+                return Unexpected{FtpError::PathNotFound};
 
             std::vector<RemoteDirEntry> list;
             for (const fs::directory_entry& dirEntry : fs::directory_iterator{remotePath})
             {
-                list.emplace_back(dirEntry.path().string(), dirEntry.file_size(), dirEntry.is_regular_file());
+                bool isFile = dirEntry.is_regular_file();
+                list.emplace_back(dirEntry.path().string(), isFile ? dirEntry.file_size() : 0, isFile);
                 const RemoteDirEntry& e = list.back();
                 if (e.isFile) LogInfo("  file %s (%zu KB)", e.path(), e.size);
                 else          LogInfo("  dir  %s", e.path());
@@ -74,52 +228,39 @@ namespace kw
 
             listed = list; // make a copy for the UI to use later
             listedPath = remotePath;
+            listedIsCached = false; // tryDownloadFirstMatchCached() did not check its write time
             return list;
         }
 
-        static RemoteDirEntry findMatchingFile(const std::vector<RemoteDirEntry>& list,
-                                               std::function<bool(std::string_view)> predicate)
+        static FtpResult<RemoteDirEntry> tryFindMatchingFile(const std::vector<RemoteDirEntry>& list,
+                                                             std::function<bool(std::string_view)> predicate)
         {
+            auto timer = ftpTimer(&FtpLatency::match);
             for (auto& e : list)
                 if (e.isFile && predicate(e.remotePath))
                     return e;
-            throw std::runtime_error{"FTP no files matched the search pattern"};
+            return Unexpected{FtpError::NoMatch};
         }
 
-        std::string downloadFile(const RemoteDirEntry& remoteFile,
-                                 std::function<void(int)> onProgress)
+        FtpResult<std::string> tryDownloadFile(const RemoteDirEntry& remoteFile,
+                                               std::function<void(int)> onProgress)
         {
+            auto timer = ftpTimer(&FtpLatency::download);
             LogInfo("DOWNLOAD %s (%zu KB)", remoteFile.path(), remoteFile.size / 1024);
             if (!remoteFile.isFile)
-                throw std::runtime_error{"FTP download failed, not a file: " + remoteFile.remotePath};
+                return Unexpected{FtpError::NotAFile};
             
             std::ifstream inFile { remoteFile.remotePath, std::ios::binary };
             if (!inFile)
-                throw std::runtime_error{"FTP download request failed: " + remoteFile.remotePath};
+                return Unexpected{FtpError::DownloadFailed};
 
-            std::string tempPath = (fs::temp_directory_path() / fs::path{remoteFile.remotePath}.filename()).string();
+            std::string tempPath = tempPathFor(remoteFile);
             std::ofstream outFile { tempPath, std::ios::binary };
             if (!outFile)
-                throw std::runtime_error{"FTP failed to create temp file at: " + tempPath};
+                return Unexpected{FtpError::TempFileFailed};
             
             // perform a "fake download"
-            int prevProgress = -1;
-            char buf[128]; // artificially small buffer for this fake example
-            for (size_t i = 0; i < remoteFile.size; ++i)
-            {
-                inFile.read(buf, sizeof(buf));
-                size_t bytesRead = inFile.gcount();
-                outFile.write(buf, bytesRead);
-
-                i += bytesRead;
-
-                // report progress to the UI
-                if (int progress = static_cast<int>((i * 100) / remoteFile.size); prevProgress != progress)
-                {
-                    prevProgress = progress;
-                    onProgress(progress); // the UI will handle synchronization
-                }
-            }
+            copyWithProgress(inFile, outFile, remoteFile.size, onProgress);
             return tempPath;
         }
     };
@@ -0,0 +1,44 @@
+#pragma once
+#include "LatencyHistogram.h"
+
+#include <atomic>
+
+namespace kw
+{
+    /** @brief Per-call latency of the FTP steps, recorded by every FTP example class once enabled */
+    struct FtpLatency
+    {
+        LatencyRecorder list;       // LIST of a remote dir
+        LatencyRecorder match;      // predicate search over the listed entries
+        LatencyRecorder download;   // DOWNLOAD of a single file
+    };
+
+    inline FtpLatency& ftpLatency()
+    {
+        static FtpLatency latency;
+        return latency;
+    }
+
+    inline std::atomic<bool>& ftpLatencyEnabled() noexcept
+    {
+        static std::atomic<bool> enabled {false};
+        return enabled;
+    }
+
+    /** @brief Turns recording into ftpLatency() on or off, it is off by default */
+    inline void enableFtpLatency(bool enable = true) noexcept
+    {
+        ftpLatencyEnabled().store(enable, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Times one FTP step into ftpLatency() while recording is enabled,
+     *        e.g. `auto timer = ftpTimer(&FtpLatency::list);`
+     */
+    inline LatencyRecorder::Timer ftpTimer(LatencyRecorder FtpLatency::* step)
+    {
+        if (!ftpLatencyEnabled().load(std::memory_order_relaxed))
+            return LatencyRecorder::Timer { nullptr };
+        return (ftpLatency().*step).time();
+    }
+}
@@ -0,0 +1,237 @@
+#pragma once
+#include "util.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef> // size_t
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace detail
+{
+    // HDR-style log-linear buckets: values below 2^SUB_BITS ns get a bucket each,
+    // every power of two above is split into 2^SUB_BITS equal buckets,
+    // so a bucket is never wider than ~3% of the values it holds
+    inline constexpr unsigned LATENCY_SUB_BITS = 5;
+    inline constexpr size_t LATENCY_SUB_BUCKETS = size_t{1} << LATENCY_SUB_BITS;
+    inline constexpr size_t LATENCY_BUCKETS = (64 - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS;
+
+    constexpr size_t latencyBucket(uint64_t ns) noexcept
+    {
+        if (ns < LATENCY_SUB_BUCKETS) return static_cast<size_t>(ns);
+        unsigned shift = static_cast<unsigned>(std::bit_width(ns)) - 1 - LATENCY_SUB_BITS;
+        return (shift + 1) * LATENCY_SUB_BUCKETS + static_cast<size_t>((ns >> shift) - LATENCY_SUB_BUCKETS);
+    }
+
+    /** @returns Highest value that lands in the bucket */
+    constexpr uint64_t latencyBucketHigh(size_t bucket) noexcept
+    {
+        if (bucket < LATENCY_SUB_BUCKETS) return bucket;
+        unsigned shift = static_cast<unsigned>(bucket / LATENCY_SUB_BUCKETS) - 1;
+        uint64_t low = (LATENCY_SUB_BUCKETS + bucket % LATENCY_SUB_BUCKETS) << shift;
+        return low + ((uint64_t{1} << shift) - 1);
+    }
+}
+
+/**
+ * @brief Latency distribution with bounded relative error, see LatencyRecorder
+ *        for recording from many threads
+ */
+class LatencyHistogram
+{
+public:
+    using duration = std::chrono::nanoseconds;
+
+    struct Summary
+    {
+        uint64_t count = 0;
+        duration p50 {0};
+        duration p99 {0};
+        duration p999 {0};
+        duration max {0};
+    };
+
+private:
+    std::vector<uint64_t> counts = std::vector<uint64_t>(detail::LATENCY_BUCKETS);
+    uint64_t total = 0;
+    uint64_t sumNs = 0;
+    uint64_t maxNs = 0;
+
+    friend class LatencyRecorder;
+
+public:
+    void record(duration d) noexcept
+    {
+        uint64_t ns = static_cast<uint64_t>(std::max(d.count(), duration::rep{0}));
+        counts[detail::latencyBucket(ns)]++;
+        total++;
+        sumNs += ns;
+        maxNs = std::max(maxNs, ns);
+    }
+
+    void merge(const LatencyHistogram& other) noexcept
+    {
+        for (size_t i = 0; i < counts.size(); i++)
+            counts[i] += other.counts[i];
+        total += other.total;
+        sumNs += other.sumNs;
+        maxNs = std::max(maxNs, other.maxNs);
+    }
+
+    uint64_t count() const noexcept { return total; }
+
+    duration max() const noexcept { return duration(maxNs); }
+
+    duration mean() const noexcept { return duration(total ? sumNs / total : 0); }
+
+    /**
+     * @param p Percentile in [0, 100]
+     * @returns Value that at least `p`% of the recorded values do not exceed,
+     *          rounded up to its bucket bound, never above max()
+     */
+    duration percentile(double p) const noexcept
+    {
+        if (!total) return duration(0);
+        uint64_t rank = static_cast<uint64_t>(p / 100.0 * static_cast<double>(total) + 0.5);
+        rank = std::clamp<uint64_t>(rank, 1, total);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts.size(); i++)
+        {
+            seen += counts[i];
+            if (seen >= rank)
+                return duration(std::min(detail::latencyBucketHigh(i), maxNs));
+        }
+        return duration(maxNs);
+    }
+
+    Summary summary() const noexcept
+    {
+        return { total, percentile(50), percentile(99), percentile(99.9), max() };
+    }
+};
+
+/**
+ * @brief Records latencies from any number of threads with no locks.
+ *
+ * Like ShardedCounter, threads get histogram shards round robin and only
+ * share one when there are more threads than shards, so concurrent recording
+ * rarely touches the same cache lines. A shard is allocated on its first
+ * record() and freed with the recorder: the memory is bounded by the shard
+ * count, however many threads come and go. snapshot() merges the shards with
+ * relaxed loads while the recording goes on.
+ */
+class LatencyRecorder
+{
+public:
+    using duration = LatencyHistogram::duration;
+    using clock = std::chrono::steady_clock;
+
+private:
+    struct alignas(CACHE_LINE_SIZE) Shard
+    {
+        std::array<std::atomic<uint64_t>, detail::LATENCY_BUCKETS> counts {};
+        std::atomic<uint64_t> sumNs {0};
+        std::atomic<uint64_t> maxNs {0};
+    };
+
+    std::unique_ptr<std::atomic<Shard*>[]> shards;
+    size_t mask;
+
+    static size_t threadIndex() noexcept
+    {
+        static std::atomic<size_t> nextIndex {0};
+        thread_local size_t index = nextIndex.fetch_add(1, std::memory_order_relaxed);
+        return index;
+    }
+
+    /** @returns The calling thread's shard, null if there was no memory for it */
+    Shard* localShard() noexcept
+    {
+        std::atomic<Shard*>& slot = shards[threadIndex() & mask];
+        Shard* shard = slot.load(std::memory_order_acquire);
+        if (shard) return shard;
+
+        Shard* created = new (std::nothrow) Shard;
+        if (!created) return nullptr;
+        if (slot.compare_exchange_strong(shard, created, std::memory_order_acq_rel, std::memory_order_acquire))
+            return created;
+        delete created; // another thread of this slot was first
+        return shard;
+    }
+
+public:
+    /** @brief Records the time from construction to destruction */
+    class Timer
+    {
+        LatencyRecorder* recorder;
+        clock::time_point start;
+
+    public:
+        /** @param r Recorder to record into, null times nothing */
+        explicit Timer(LatencyRecorder* r) noexcept
+        : recorder {r}, start {r ? clock::now() : clock::time_point {}}
+        {}
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+        ~Timer() { if (recorder) recorder->record(clock::now() - start); }
+    };
+
+    /** @param shardCount Rounded up to a power of two, defaults to one shard per hardware thread */
+    explicit LatencyRecorder(size_t shardCount = std::thread::hardware_concurrency())
+    : shards {std::make_unique<std::atomic<Shard*>[]>(std::bit_ceil(std::max<size_t>(shardCount, 1)))},
+      mask {std::bit_ceil(std::max<size_t>(shardCount, 1)) - 1}
+    {}
+
+    LatencyRecorder(const LatencyRecorder&) = delete;
+    LatencyRecorder& operator=(const LatencyRecorder&) = delete;
+
+    /** @brief Recording threads must be done before the recorder is destroyed */
+    ~LatencyRecorder()
+    {
+        for (size_t i = 0; i <= mask; i++)
+            delete shards[i].load(std::memory_order_acquire);
+    }
+
+    /** @brief Drops the sample if the shard cannot be allocated, so that timing never throws */
+    void record(duration d) noexcept
+    {
+        Shard* shard = localShard();
+        if (!shard) return;
+        uint64_t ns = static_cast<uint64_t>(std::max(d.count(), duration::rep{0}));
+        shard->counts[detail::latencyBucket(ns)].fetch_add(1, std::memory_order_relaxed);
+        shard->sumNs.fetch_add(ns, std::memory_order_relaxed);
+        uint64_t max = shard->maxNs.load(std::memory_order_relaxed);
+        while (ns > max && !shard->maxNs.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {}
+    }
+
+    /** @brief Times the enclosing scope: `auto timer = recorder.time();` */
+    [[nodiscard]] Timer time() noexcept { return Timer { this }; }
+
+    size_t shardCount() const noexcept { return mask + 1; }
+
+    /** @returns Merge of every thread's samples, may miss the ones being recorded right now */
+    LatencyHistogram snapshot() const
+    {
+        LatencyHistogram merged;
+        for (size_t shard = 0; shard <= mask; shard++)
+        {
+            const Shard* s = shards[shard].load(std::memory_order_acquire);
+            if (!s) continue;
+            for (size_t i = 0; i < detail::LATENCY_BUCKETS; i++)
+            {
+                uint64_t n = s->counts[i].load(std::memory_order_relaxed);
+                merged.counts[i] += n;
+                merged.total += n; // consistent with the buckets, for the percentiles
+            }
+            merged.sumNs += s->sumNs.load(std::memory_order_relaxed);
+            merged.maxNs = std::max(merged.maxNs, s->maxNs.load(std::memory_order_relaxed));
+        }
+        return merged;
+    }
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint> // uint32_t
+#include <functional>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief Value computed by `F` on the first get(), single-threaded.
+ *        For a value shared between threads use ConcurrentLazy.
+ */
+template<typename T, typename F = std::function<T()>>
+class Lazy
+{
+    F compute;
+    mutable std::optional<T> value;
+
+public:
+    explicit Lazy(F compute) : compute {std::move(compute)} {}
+
+    const T& get() const
+    {
+        if (!value)
+            value.emplace(std::invoke(compute));
+        return *value;
+    }
+
+    bool isComputed() const noexcept { return value.has_value(); }
+};
+
+template<typename F>
+Lazy(F) -> Lazy<std::invoke_result_t<F&>, F>;
+
+/**
+ * @brief Value computed by `F` on the first get(), safe to share between threads.
+ *
+ * Once the value is there, get() is a single acquire load. Concurrent first
+ * callers run `F` exactly once: one of them computes, the others sleep on the
+ * state word (a futex on Linux) until it is done. If `F` throws, the exception
+ * goes to that caller and the next get() tries again, like std::call_once.
+ */
+template<typename T, typename F = std::function<T()>>
+class ConcurrentLazy
+{
+    enum : uint32_t { EMPTY, RUNNING, READY };
+
+    mutable std::atomic<uint32_t> state {EMPTY};
+    mutable std::optional<T> value; // written once, before `state` becomes READY
+    F compute;
+
+    const T& computeOrWait() const
+    {
+        uint32_t s = state.load(std::memory_order_acquire);
+        while (s != READY)
+        {
+            if (s == RUNNING)
+            {
+                state.wait(RUNNING, std::memory_order_acquire);
+                s = state.load(std::memory_order_acquire);
+                continue;
+            }
+            if (!state.compare_exchange_weak(s, RUNNING, std::memory_order_acquire))
+                continue;
+
+            try
+            {
+                value.emplace(std::invoke(compute));
+            }
+            catch (...)
+            {
+                state.store(EMPTY, std::memory_order_release);
+                state.notify_all(); // one of the waiters takes over
+                throw;
+            }
+            state.store(READY, std::memory_order_release);
+            state.notify_all();
+            break;
+        }
+        return *value;
+    }
+
+public:
+    explicit ConcurrentLazy(F compute) : compute {std::move(compute)} {}
+
+    ConcurrentLazy(const ConcurrentLazy&) = delete;
+    ConcurrentLazy& operator=(const ConcurrentLazy&) = delete;
+
+    const T& get() const
+    {
+        if (state.load(std::memory_order_acquire) == READY) [[likely]]
+            return *value;
+        return computeOrWait();
+    }
+
+    bool isComputed() const noexcept { return state.load(std::memory_order_acquire) == READY; }
+};
+
+template<typename F>
+ConcurrentLazy(F) -> ConcurrentLazy<std::invoke_result_t<F&>, F>;
@@ -0,0 +1,178 @@
+#pragma once
+#include "EpochReclaimer.h"
+
+#include <atomic>
+#include <cstddef> // size_t
+#include <cstdint> // uintptr_t
+#include <functional>
+#include <optional>
+#include <utility>
+
+/**
+ * @brief Ordered set as a singly linked list that threads share without a lock,
+ *        the concurrent sibling of SmartPtrLinkedList.
+ *
+ * Harris' algorithm, in Michael's variant: erase() first marks the low bit of
+ * the node's `next` link, so no insert can attach behind the node any more,
+ * then unlinks it. Every search unlinks the marked nodes it passes, so a
+ * stalled eraser does not block anyone. Unlinked nodes are retired to
+ * EpochReclaimer and deleted once no thread can be looking at them; a
+ * traversal costs plain loads, where hazard pointers would need a fenced
+ * store per node.
+ * insert(), erase() and contains() are lock-free and linearizable.
+ * forEach() visits in order and is weakly consistent: it sees every value that
+ * is there for the whole traversal and none twice.
+ */
+template<typename T, typename Compare = std::less<T>>
+class LockFreeLinkedList
+{
+    struct Node
+    {
+        const T value;
+        std::atomic<uintptr_t> next {0}; // Node* with the erased mark in bit 0
+    };
+
+    static constexpr uintptr_t MARK = 1;
+    static Node* ptrOf(uintptr_t link) noexcept { return reinterpret_cast<Node*>(link & ~MARK); }
+    static bool isMarked(uintptr_t link) noexcept { return link & MARK; }
+    static uintptr_t linkTo(Node* node) noexcept { return reinterpret_cast<uintptr_t>(node); }
+
+    std::atomic<uintptr_t> head {0};
+    Compare less;
+
+    struct Window
+    {
+        std::atomic<uintptr_t>* prev; // the link to `cur`, in head or the previous node
+        Node* cur;                    // null at the end of the list
+    };
+
+    /** @returns The first unmarked node `before` says no to, empty if the list changed under us */
+    template<typename Before>
+    std::optional<Window> trySearch(Before& before)
+    {
+        std::atomic<uintptr_t>* prev = &head;
+        Node* cur = ptrOf(prev->load(std::memory_order_acquire));
+        while (cur)
+        {
+            uintptr_t next = cur->next.load(std::memory_order_acquire);
+            if (isMarked(next))
+            {
+                // fails if `prev` got marked itself or an insert came between
+                uintptr_t expected = linkTo(cur);
+                if (!prev->compare_exchange_strong(expected, linkTo(ptrOf(next))))
+                    return std::nullopt;
+                EpochReclaimer::retire(cur);
+            }
+            else
+            {
+                if (!before(cur->value)) return Window { prev, cur };
+                prev = &cur->next;
+            }
+            cur = ptrOf(next);
+        }
+        return Window { prev, nullptr };
+    }
+
+    /** @brief Must run inside an EpochReclaimer::Guard, which keeps the window alive */
+    template<typename Before>
+    Window search(Before before)
+    {
+        while (true)
+            if (auto window = trySearch(before))
+                return *window;
+    }
+
+public:
+    LockFreeLinkedList() = default;
+    explicit LockFreeLinkedList(Compare less) : less {std::move(less)} {}
+
+    LockFreeLinkedList(const LockFreeLinkedList&) = delete;
+    LockFreeLinkedList& operator=(const LockFreeLinkedList&) = delete;
+
+    /** @brief No thread may use the list anymore, nodes already retired are freed by EpochReclaimer */
+    ~LockFreeLinkedList()
+    {
+        for (Node* node = ptrOf(head.load()); node; )
+            delete std::exchange(node, ptrOf(node->next.load()));
+    }
+
+    /** @returns false if an equal value is already there */
+    bool insert(T value)
+    {
+        EpochReclaimer::Guard guard;
+        Node* node = new Node { std::move(value) };
+        while (true)
+        {
+            Window w = search([&](const T& v) { return less(v, node->value); });
+            if (w.cur && !less(node->value, w.cur->value))
+            {
+                delete node;
+                return false;
+            }
+            node->next.store(linkTo(w.cur), std::memory_order_relaxed);
+            uintptr_t expected = linkTo(w.cur);
+            if (w.prev->compare_exchange_strong(expected, linkTo(node)))
+                return true;
+        }
+    }
+
+    /** @returns false if there was no such value */
+    bool erase(const T& value)
+    {
+        EpochReclaimer::Guard guard;
+        auto before = [&](const T& v) { return less(v, value); };
+        while (true)
+        {
+            Window w = search(before);
+            if (!w.cur || less(value, w.cur->value))
+                return false;
+
+            uintptr_t next = w.cur->next.load();
+            if (isMarked(next) || !w.cur->next.compare_exchange_strong(next, next | MARK))
+                continue; // another erase or an insert behind it came first
+
+            uintptr_t expected = linkTo(w.cur);
+            if (w.prev->compare_exchange_strong(expected, next))
+                EpochReclaimer::retire(w.cur);
+            else
+                search(before); // unlinks it on the way
+            return true;
+        }
+    }
+
+    bool contains(const T& value)
+    {
+        EpochReclaimer::Guard guard;
+        Window w = search([&](const T& v) { return less(v, value); });
+        return w.cur && !less(value, w.cur->value);
+    }
+
+    /** @brief Calls `visit` with every value in order, see the class comment for concurrent changes */
+    template<typename F>
+    void forEach(F&& visit)
+    {
+        EpochReclaimer::Guard guard;
+        std::optional<T> last; // a restarted search skips what was visited
+        search([&](const T& v) {
+            if (!last || less(*last, v))
+            {
+                visit(v);
+                last.emplace(v);
+            }
+            return true;
+        });
+    }
+
+    size_t size()
+    {
+        size_t result = 0;
+        forEach([&result](const T&) { result++; });
+        return result;
+    }
+
+    bool empty()
+    {
+        EpochReclaimer::Guard guard;
+        return search([](const T&) { return false; }).cur == nullptr;
+    }
+};
@@ -0,0 +1,220 @@
+#pragma once
+#include "util.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstddef> // size_t
+#include <cstdint> // uint64_t
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace detail
+{
+    template<typename> struct SignatureOf;
+    template<typename R, typename... Args>
+    struct SignatureOf<std::function<R(Args...)>> { using type = R(Args...); };
+
+    /** @brief Hashes an argument tuple, the bits are mixed so that the shard index is usable */
+    struct TupleHash
+    {
+        template<typename... Ts>
+        size_t operator()(const std::tuple<Ts...>& t) const noexcept
+        {
+            uint64_t h = 0;
+            std::apply([&h](const auto&... x) {
+                ((h = (h ^ std::hash<std::decay_t<decltype(x)>>{}(x)) * 0x9e3779b97f4a7c15ull), ...);
+            }, t);
+            h ^= h >> 29; // splitmix64 finalizer
+            h *= 0xbf58476d1ce4e5b9ull;
+            h ^= h >> 32;
+            return static_cast<size_t>(h);
+        }
+    };
+}
+
+template<typename Signature, typename F = std::function<Signature>>
+class Memoized;
+
+/**
+ * @brief Caches the results of `F` per argument tuple, shared between threads.
+ *
+ * The keys are spread over shards with a lock each, so threads that look up
+ * different keys rarely meet. Every shard holds at most capacity / shards
+ * results and evicts with the CLOCK algorithm: a hit sets the entry's
+ * reference bit, the clock hand clears set bits and evicts the first entry
+ * it finds without one. Concurrent misses on the same key compute once
+ * (single-flight): the first caller computes, the others wait for its result.
+ * A failed computation is not cached, its exception goes to every waiter.
+ */
+template<typename R, typename... Args, typename F>
+class Memoized<R(Args...), F>
+{
+public:
+    using Key = std::tuple<std::decay_t<Args>...>;
+
+    struct Stats
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;      // computations started
+        uint64_t joins = 0;       // waited for a computation in flight
+        uint64_t evictions = 0;
+        size_t size = 0;
+
+        double hitRate() const noexcept
+        {
+            uint64_t lookups = hits + misses + joins;
+            return lookups ? double(hits + joins) / lookups : 0;
+        }
+    };
+
+private:
+    struct Entry
+    {
+        Key key;
+        std::shared_future<R> result; // not ready while the computation is in flight
+        bool referenced = true;
+        const void* owner = nullptr; // the promise behind `result`, identifies this computation
+    };
+
+    struct alignas(CACHE_LINE_SIZE) Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<Key, size_t, detail::TupleHash> index; // key -> position in `entries`
+        std::vector<Entry> entries; // the clock ring
+        size_t hand = 0;
+        Stats stats;
+
+        void erase(size_t i)
+        {
+            index.erase(entries[i].key);
+            if (i != entries.size() - 1)
+            {
+                entries[i] = std::move(entries.back());
+                index[entries[i].key] = i;
+            }
+            entries.pop_back();
+            if (hand >= entries.size()) hand = 0;
+        }
+
+        /** @returns Position of a free entry, evicts one when the shard is full */
+        size_t reserve(size_t limit)
+        {
+            if (entries.size() < limit)
+            {
+                entries.emplace_back();
+                return entries.size() - 1;
+            }
+            // at most two sweeps: the first one clears every reference bit
+            while (entries[hand].referenced)
+            {
+                entries[hand].referenced = false;
+                hand = (hand + 1) % entries.size();
+            }
+            size_t victim = hand;
+            index.erase(entries[victim].key);
+            hand = (hand + 1) % entries.size();
+            stats.evictions++;
+            return victim;
+        }
+    };
+
+    F fn;
+    size_t shardCapacity;
+    std::unique_ptr<Shard[]> shards;
+    size_t shardMask;
+
+    Shard& shardOf(size_t hash) const noexcept { return shards[(hash >> 7) & shardMask]; }
+
+public:
+    /**
+     * @param capacity Max number of cached results, at least one per shard
+     * @param shardCount Is rounded up to the nearest power of two
+     */
+    explicit Memoized(F fn, size_t capacity = 1024, size_t shardCount = 16)
+    : fn {std::move(fn)}
+    , shardCapacity {std::max<size_t>(capacity / std::bit_ceil(std::max<size_t>(shardCount, 1)), 1)}
+    , shards {std::make_unique<Shard[]>(std::bit_ceil(std::max<size_t>(shardCount, 1)))}
+    , shardMask {std::bit_ceil(std::max<size_t>(shardCount, 1)) - 1}
+    {}
+
+    Memoized(const Memoized&) = delete;
+    Memoized& operator=(const Memoized&) = delete;
+
+    size_t capacity() const noexcept { return shardCapacity * (shardMask + 1); }
+
+    R operator()(const std::decay_t<Args>&... args)
+    {
+        Key key { args... };
+        size_t hash = detail::TupleHash{}(key);
+        Shard& shard = shardOf(hash);
+
+        std::promise<R> promise;
+        std::unique_lock lock {shard.mutex};
+        if (auto it = shard.index.find(key); it != shard.index.end())
+        {
+            Entry& e = shard.entries[it->second];
+            e.referenced = true;
+            bool ready = e.result.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+            (ready ? shard.stats.hits : shard.stats.joins)++;
+            std::shared_future<R> result = e.result;
+            lock.unlock(); // the shard stays usable while we wait for the computation
+            return result.get();
+        }
+
+        size_t i = shard.reserve(shardCapacity);
+        shard.entries[i] = Entry { key, promise.get_future().share(), true, &promise };
+        shard.index[key] = i;
+        shard.stats.misses++;
+        lock.unlock();
+
+        try
+        {
+            R result = std::invoke(fn, args...);
+            promise.set_value(result);
+            return result;
+        }
+        catch (...)
+        {
+            promise.set_exception(std::current_exception());
+            lock.lock();
+            // the entry may be evicted already, or even replaced by a new computation
+            if (auto it = shard.index.find(key); it != shard.index.end()
+                && shard.entries[it->second].owner == &promise)
+                shard.erase(it->second);
+            throw;
+        }
+    }
+
+    /** @returns Counters summed over the shards */
+    Stats stats() const
+    {
+        Stats total;
+        for (size_t i = 0; i <= shardMask; i++)
+        {
+            std::lock_guard lock {shards[i].mutex};
+            const Stats& s = shards[i].stats;
+            total.hits += s.hits;
+            total.misses += s.misses;
+            total.joins += s.joins;
+            total.evictions += s.evictions;
+            total.size += shards[i].entries.size();
+        }
+        return total;
+    }
+};
+
+template<typename F>
+Memoized(F) -> Memoized<typename detail::SignatureOf<decltype(std::function{std::declval<F>()})>::type, F>;
+template<typename F>
+Memoized(F, size_t) -> Memoized<typename detail::SignatureOf<decltype(std::function{std::declval<F>()})>::type, F>;
+template<typename F>
+Memoized(F, size_t, size_t) -> Memoized<typename detail::SignatureOf<decltype(std::function{std::declval<F>()})>::type, F>;
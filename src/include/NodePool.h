@@ -0,0 +1,217 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef> // size_t, max_align_t
+#include <new>
+#include <utility>
+
+namespace detail
+{
+    /**
+     * @brief Hands out fixed-size blocks carved from slabs, each slab twice
+     *        the size of the one before (up to MAX_SLAB_BLOCKS blocks).
+     *        Freed blocks go to a free list and are reused; the slabs are
+     *        returned to the system once no owner and no block is left.
+     *        Not thread-safe, the counts included.
+     */
+    class NodePool
+    {
+        static constexpr size_t FIRST_SLAB_BLOCKS = 32;
+        static constexpr size_t MAX_SLAB_BLOCKS = 4096;
+
+        struct FreeBlock { FreeBlock* next; };
+        struct Slab { Slab* next; };
+
+        size_t owners = 1;
+        size_t liveBlocks = 0;  // handed out and not freed yet
+        size_t blockSize = 0;   // fixed by the first allocation
+        size_t blockAlign = 0;
+        size_t slabBlocks = FIRST_SLAB_BLOCKS;
+        size_t freeBlocks = 0;
+        FreeBlock* freeList = nullptr;
+        Slab* slabs = nullptr;
+
+        size_t headerSize() const noexcept { return std::max(sizeof(Slab), blockAlign); }
+
+        void grow(size_t blocks)
+        {
+            void* memory = ::operator new(headerSize() + blocks * blockSize, std::align_val_t{blockAlign});
+            slabs = ::new (memory) Slab { slabs };
+            std::byte* first = static_cast<std::byte*>(memory) + headerSize();
+            for (size_t i = blocks; i-- > 0; )
+                freeList = ::new (first + i * blockSize) FreeBlock { freeList };
+            freeBlocks += blocks;
+        }
+
+    public:
+        NodePool() noexcept = default;
+        ~NodePool()
+        {
+            while (slabs)
+            {
+                Slab* next = slabs->next;
+                ::operator delete(slabs, std::align_val_t{blockAlign});
+                slabs = next;
+            }
+        }
+
+        NodePool(const NodePool&) = delete;
+        NodePool& operator=(const NodePool&) = delete;
+
+        void retain() noexcept { owners++; }
+
+        void release() noexcept
+        {
+            if (--owners == 0 && liveBlocks == 0)
+                delete this;
+        }
+
+        /** @returns true if the only owner could free the pool right away */
+        bool unused() const noexcept { return owners == 1 && liveBlocks == 0; }
+
+        /** @returns true if blocks of this size come from the pool, the first call decides */
+        bool serves(size_t size, size_t align) noexcept
+        {
+            if (blockSize == 0)
+            {
+                blockAlign = std::max(align, alignof(FreeBlock));
+                blockSize = (std::max(size, sizeof(FreeBlock)) + blockAlign - 1) / blockAlign * blockAlign;
+            }
+            return size <= blockSize && align <= blockAlign;
+        }
+
+        void* allocate()
+        {
+            if (!freeList)
+            {
+                grow(slabBlocks);
+                slabBlocks = std::min(slabBlocks * 2, MAX_SLAB_BLOCKS);
+            }
+            FreeBlock* block = freeList;
+            freeList = block->next;
+            freeBlocks--;
+            liveBlocks++;
+            return block;
+        }
+
+        /** @returns true if no owner is left and this was the last block, the caller frees the pool then */
+        [[nodiscard]] bool deallocate(void* p) noexcept
+        {
+            freeList = ::new (p) FreeBlock { freeList };
+            freeBlocks++;
+            return --liveBlocks == 0 && owners == 0;
+        }
+
+        /** @brief Makes sure the next `blocks` allocations come from one slab at most, once the block size is known */
+        void reserve(size_t blocks)
+        {
+            if (blockSize != 0 && freeBlocks < blocks)
+                grow(blocks - freeBlocks);
+        }
+    };
+}
+
+/**
+ * @brief Allocator that takes single objects from a slab pool, meant for
+ *        list nodes and `std::allocate_shared`.
+ *
+ * A default-constructed allocator owns a pool it creates on first use, so
+ * an allocator that never allocates costs nothing. The pool lives while an
+ * owning allocator or a block from it does, which keeps it alive for nodes
+ * that outlive their list.
+ *
+ * Copy construction and rebinding, which allocate_shared does a few times
+ * per node, give a non-owning view that only costs a pointer copy; a view
+ * is valid while the allocator it was copied from or a block it handed out
+ * is alive. Copy assignment shares ownership, for containers that share
+ * nodes with each other. Moving hands the pool over and leaves an owner
+ * without one, so a moved-to list never shares a pool with the list it
+ * came from. Arrays and objects that do not fit the pool's block size go
+ * to operator new. Like the containers that use it, a pool must not be
+ * used from two threads at once.
+ */
+template<typename T>
+class NodePoolAllocator
+{
+    template<typename> friend class NodePoolAllocator;
+
+    // created by the first allocation or copy, null again after a move or trim()
+    mutable detail::NodePool* pool = nullptr;
+    bool owner = true;
+
+    /** @returns The pool, created if there is none yet */
+    detail::NodePool* sharedPool() const
+    {
+        if (!pool) pool = new detail::NodePool;
+        return pool;
+    }
+
+    bool pooled(size_t n) const noexcept { return n == 1 && pool && pool->serves(sizeof(T), alignof(T)); }
+
+public:
+    using value_type = T;
+
+    NodePoolAllocator() noexcept = default;
+    NodePoolAllocator(const NodePoolAllocator& other) noexcept : pool {other.sharedPool()}, owner {false} {}
+    NodePoolAllocator(NodePoolAllocator&& other) noexcept
+    : pool {std::exchange(other.pool, nullptr)}
+    , owner {std::exchange(other.owner, true)}
+    {}
+
+    template<typename U>
+    NodePoolAllocator(const NodePoolAllocator<U>& other) noexcept : pool {other.sharedPool()}, owner {false} {}
+
+    NodePoolAllocator& operator=(const NodePoolAllocator& other) noexcept
+    {
+        if (other.pool) other.pool->retain();
+        if (owner && pool) pool->release();
+        pool = other.pool;
+        owner = true;
+        return *this;
+    }
+
+    NodePoolAllocator& operator=(NodePoolAllocator&& other) noexcept
+    {
+        std::swap(pool, other.pool);
+        std::swap(owner, other.owner);
+        return *this;
+    }
+
+    ~NodePoolAllocator() { if (owner && pool) pool->release(); }
+
+    T* allocate(size_t n)
+    {
+        if (n == 1) sharedPool();
+        if (pooled(n))
+            return static_cast<T*>(pool->allocate());
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{alignof(T)}));
+    }
+
+    void deallocate(T* p, size_t n) noexcept
+    {
+        if (pooled(n))
+        {
+            // only a view can outlive the owners, an owner never frees the pool here
+            if (pool->deallocate(p) && !owner)
+                delete pool;
+        }
+        else
+            ::operator delete(p, std::align_val_t{alignof(T)});
+    }
+
+    /** @brief Prepares the pool for `n` single-object allocations, see NodePool::reserve */
+    void reserve(size_t n) { if (pool) pool->reserve(n); }
+
+    /** @brief Frees the pool if this allocator is its only user, the next allocation starts a new one */
+    void trim() noexcept
+    {
+        if (owner && pool && pool->unused())
+        {
+            pool->release();
+            pool = nullptr;
+        }
+    }
+
+    template<typename U>
+    bool operator==(const NodePoolAllocator<U>& other) const noexcept { return pool == other.pool; }
+};
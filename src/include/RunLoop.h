@@ -0,0 +1,162 @@
+#pragma once
+
+#include <coroutine>
+#include <condition_variable>
+#include <cstddef> // size_t
+#include <mutex>
+#include <utility>
+
+/**
+ * @brief Manual event loop that resumes coroutines on the thread driving it.
+ *
+ * Coroutines move onto the loop with `co_await loop.schedule()`; the owner
+ * (e.g. the UI thread) drives it with run(), run_one() or run_until_idle().
+ * The ready queue is intrusive: every queued Operation lives inside the
+ * awaitable of the suspended coroutine, so scheduling never allocates.
+ * Any thread may schedule onto the loop.
+ */
+class RunLoop
+{
+public:
+    /** @brief Ready queue node, embedded in the awaitables that park on the loop */
+    struct Operation
+    {
+        std::coroutine_handle<> handle;
+        Operation* next = nullptr;
+    };
+
+private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    Operation* head = nullptr;
+    Operation* tail = nullptr;
+    bool stopped = false;
+
+    static RunLoop*& currentRef() noexcept
+    {
+        thread_local RunLoop* loop = nullptr;
+        return loop;
+    }
+
+    struct ScheduleAwaitable : Operation
+    {
+        RunLoop& loop;
+
+        explicit ScheduleAwaitable(RunLoop& l) noexcept : loop {l} {}
+
+        bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> coro) noexcept
+        {
+            this->handle = coro;
+            loop.post(*this);
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    // marks the calling thread as driving this loop
+    auto enter() noexcept
+    {
+        struct scope
+        {
+            RunLoop* previous;
+            ~scope() { currentRef() = previous; }
+        };
+        return scope { std::exchange(currentRef(), this) };
+    }
+
+    Operation* pop() noexcept
+    {
+        Operation* op = head;
+        if (op)
+        {
+            head = op->next;
+            if (!head) tail = nullptr;
+        }
+        return op;
+    }
+
+public:
+    RunLoop() noexcept = default;
+    RunLoop(const RunLoop&) = delete;
+    RunLoop& operator=(const RunLoop&) = delete;
+
+    /** @returns Loop being driven by the calling thread, nullptr if none */
+    static RunLoop* current() noexcept { return currentRef(); }
+
+    /** @brief Suspends the awaiting coroutine and resumes it on the loop thread */
+    [[nodiscard]] ScheduleAwaitable schedule() noexcept { return ScheduleAwaitable { *this }; }
+
+    /** @brief Queues a parked coroutine, `op` must stay alive until it is resumed */
+    void post(Operation& op) noexcept
+    {
+        std::lock_guard lock {mutex};
+        op.next = nullptr;
+        if (tail) tail->next = &op;
+        else      head = &op;
+        tail = &op;
+        cv.notify_one();
+    }
+
+    /**
+     * @brief Blocks until a coroutine is ready and resumes it
+     * @returns false if the loop was stopped instead
+     */
+    bool run_one()
+    {
+        auto scope = enter();
+        Operation* op;
+        {
+            std::unique_lock lock {mutex};
+            cv.wait(lock, [this] { return head || stopped; });
+            op = pop();
+        }
+        if (!op) return false;
+        op->handle.resume(); // `op` may be destroyed after this
+        return true;
+    }
+
+    /**
+     * @brief Resumes ready coroutines without blocking, including the ones
+     *        scheduled while running, until the queue is empty
+     * @returns Number of resumed coroutines
+     */
+    size_t run_until_idle()
+    {
+        auto scope = enter();
+        size_t resumed = 0;
+        while (true)
+        {
+            Operation* op;
+            {
+                std::lock_guard lock {mutex};
+                op = pop();
+            }
+            if (!op) break;
+            op->handle.resume();
+            resumed++;
+        }
+        return resumed;
+    }
+
+    /** @brief Resumes coroutines as they become ready until stop() is called */
+    void run()
+    {
+        while (run_one()) {}
+    }
+
+    /** @brief Makes run() and run_one() return once no coroutine is ready */
+    void stop()
+    {
+        std::lock_guard lock {mutex};
+        stopped = true;
+        cv.notify_all();
+    }
+
+    bool isStopped()
+    {
+        std::lock_guard lock {mutex};
+        return stopped;
+    }
+};
@@ -0,0 +1,68 @@
+#pragma once
+#include "Task.h"
+
+#include <concepts>
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+/**
+ * @brief Anything coroutines can hop onto with `co_await executor.schedule()`,
+ *        e.g. RunLoop
+ */
+template<typename E>
+concept Executor = requires(E& executor) {
+    executor.schedule().await_ready();
+};
+
+namespace detail
+{
+    /** @brief Eagerly started coroutine that nobody awaits, frees itself when done */
+    struct DetachedTask
+    {
+        struct promise_type
+        {
+            DetachedTask get_return_object() noexcept { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() noexcept {}
+            void unhandled_exception() noexcept { std::terminate(); }
+        };
+    };
+}
+
+/**
+ * @brief Starts the task on the executor.
+ *        The awaiting coroutine continues wherever the task completes.
+ */
+template<Executor E, typename T>
+Task<T> schedule_on(E& executor, Task<T> task)
+{
+    co_await executor.schedule();
+    co_return co_await std::move(task);
+}
+
+/**
+ * @brief Runs the task where it is awaited, then moves the awaiting coroutine
+ *        onto the executor, also when the task fails.
+ */
+template<Executor E, typename T>
+Task<T> resume_on(E& executor, Task<T> task)
+{
+    co_await task.when_ready();
+    co_await executor.schedule();
+    co_return co_await std::move(task); // ready, only fetches the result
+}
+
+/**
+ * @brief Calls `fn` on the executor without waiting for it, e.g. to deliver
+ *        a callback on the UI loop. `fn` must not throw.
+ */
+template<Executor E, std::invocable F>
+void spawn_on(E& executor, F fn)
+{
+    [](E& executor, F fn) -> detail::DetachedTask {
+        co_await executor.schedule();
+        fn();
+    }(executor, std::move(fn));
+}
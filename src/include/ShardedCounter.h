@@ -0,0 +1,66 @@
+#pragma once
+#include "util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef> // size_t
+#include <memory>
+#include <thread>
+
+/**
+ * @brief Counter for many concurrent writers and rare readers.
+ *
+ * A single std::atomic that every thread increments becomes one cache line
+ * bouncing between all cores. Here each thread adds to its own shard, padded
+ * to a full cache line, so writers on different shards never touch the same
+ * line; read() sums the shards. Threads get shards round robin, they only
+ * share one when there are more threads than shards.
+ *
+ * read() is not a snapshot: adds running concurrently may or may not be
+ * counted, but every add that happened before read() is.
+ */
+template<typename T = long long>
+class ShardedCounter
+{
+    struct alignas(CACHE_LINE_SIZE) Shard
+    {
+        std::atomic<T> value {0};
+    };
+
+    std::unique_ptr<Shard[]> shards;
+    size_t mask;
+
+    static size_t threadIndex() noexcept
+    {
+        static std::atomic<size_t> nextIndex {0};
+        thread_local size_t index = nextIndex.fetch_add(1, std::memory_order_relaxed);
+        return index;
+    }
+
+public:
+    /** @param shardCount Rounded up to a power of two, defaults to one shard per hardware thread */
+    explicit ShardedCounter(size_t shardCount = std::thread::hardware_concurrency())
+    : shards {std::make_unique<Shard[]>(std::bit_ceil(std::max<size_t>(shardCount, 1)))},
+      mask {std::bit_ceil(std::max<size_t>(shardCount, 1)) - 1}
+    {}
+
+    ShardedCounter(const ShardedCounter&) = delete;
+    ShardedCounter& operator=(const ShardedCounter&) = delete;
+
+    void add(T delta = 1) noexcept
+    {
+        shards[threadIndex() & mask].value.fetch_add(delta, std::memory_order_relaxed);
+    }
+
+    /** @returns Sum of all shards */
+    T read() const noexcept
+    {
+        T sum = 0;
+        for (size_t i = 0; i <= mask; i++)
+            sum += shards[i].value.load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    size_t shardCount() const noexcept { return mask + 1; }
+};
@@ -0,0 +1,96 @@
+#pragma once
+#include "util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef> // size_t
+#include <memory>
+
+/**
+ * @brief One-shot start barrier for contention benchmarks.
+ *
+ * A std::shared_future start signal wakes its waiters one by one through a
+ * mutex and a condition variable, so the threads start milliseconds apart.
+ * Here participants spin on a flag first and only fall back to a futex-style
+ * std::atomic::wait if the gate stays closed for long; a released spinner
+ * sees the flag within nanoseconds.
+ *
+ * Every participant stamps its departure time into its own cache line,
+ * skew() tells how far apart the threads actually started.
+ */
+class StartGate
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+private:
+    struct alignas(CACHE_LINE_SIZE) Slot
+    {
+        clock::time_point departed;
+    };
+
+    const size_t participants;
+    const size_t spinCount;
+    std::unique_ptr<Slot[]> slots;
+    clock::time_point opened;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> arrived {0};
+    alignas(CACHE_LINE_SIZE) std::atomic<bool> isOpen {false};
+
+public:
+    /**
+     * @param participants Number of threads that will call arriveAndWait()
+     * @param spinCount Polls of the flag before a participant goes to sleep
+     */
+    explicit StartGate(size_t participants, size_t spinCount = 1 << 16)
+    : participants {participants}, spinCount {spinCount}, slots {std::make_unique<Slot[]>(participants)}
+    {}
+
+    StartGate(const StartGate&) = delete;
+    StartGate& operator=(const StartGate&) = delete;
+
+    /** @brief Blocks the participant until open(), at most `participants` calls */
+    void arriveAndWait() noexcept
+    {
+        size_t slot = arrived.fetch_add(1, std::memory_order_acq_rel);
+        if (slot + 1 == participants)
+            arrived.notify_one();
+
+        for (size_t i = 0; i < spinCount && !isOpen.load(std::memory_order_acquire); i++)
+            cpuRelax();
+        while (!isOpen.load(std::memory_order_acquire))
+            isOpen.wait(false, std::memory_order_acquire);
+
+        slots[slot].departed = clock::now();
+    }
+
+    /** @brief Waits until every participant has arrived, then releases them all at once */
+    void open() noexcept
+    {
+        for (size_t n; (n = arrived.load(std::memory_order_acquire)) < participants; )
+            arrived.wait(n, std::memory_order_acquire);
+
+        opened = clock::now();
+        isOpen.store(true, std::memory_order_release);
+        isOpen.notify_all();
+    }
+
+    /** @returns When open() released the participants */
+    clock::time_point openedAt() const noexcept { return opened; }
+
+    /** @returns Time between the first and the last participant leaving, valid once they all left */
+    clock::duration skew() const noexcept
+    {
+        auto [first, last] = std::minmax_element(slots.get(), slots.get() + participants,
+            [](const Slot& a, const Slot& b) { return a.departed < b.departed; });
+        return participants ? last->departed - first->departed : clock::duration::zero();
+    }
+
+    /** @returns Time between open() and the last participant leaving, valid once they all left */
+    clock::duration wakeLatency() const noexcept
+    {
+        auto last = std::max_element(slots.get(), slots.get() + participants,
+            [](const Slot& a, const Slot& b) { return a.departed < b.departed; });
+        return participants ? last->departed - opened : clock::duration::zero();
+    }
+};
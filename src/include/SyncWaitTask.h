@@ -1,5 +1,6 @@
 #pragma once
 #include "Task.h"
+#include "RunLoop.h"
 
 #include <coroutine>
 #include <utility>
@@ -134,7 +135,7 @@ SyncWaitTask<T> startTask(Task<T>&& t)
 }
 
 template<>
-SyncWaitTask<void> startTask(Task<void>&& t)
+inline SyncWaitTask<void> startTask(Task<void>&& t)
 {
     co_await std::move(t);
 }
@@ -146,3 +147,98 @@ std::future<SyncWaitTask<T>> startTaskAsync(Task<T>&& t)
         return startTask(std::move(t));
     });
 }
+
+
+/**
+ * @brief Coroutine that stops its RunLoop once it reaches the final suspend point
+ */
+class SyncWaitEvent final
+{
+public:
+    struct promise_type
+    {
+        RunLoop* loop = nullptr;
+
+        SyncWaitEvent get_return_object() noexcept
+        {
+            return SyncWaitEvent { std::coroutine_handle<promise_type>::from_promise(*this) };
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        auto final_suspend() noexcept
+        {
+            struct finish_awaitable
+            {
+                bool await_ready() const noexcept { return false; }
+
+                void await_suspend(std::coroutine_handle<promise_type> coro) noexcept
+                {
+                    coro.promise().loop->stop();
+                }
+
+                void await_resume() noexcept {}
+            };
+            return finish_awaitable {};
+        }
+
+        void return_void() noexcept {}
+
+        // exceptions stay in the awaited task, see Task::when_ready()
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+
+private:
+    using CoroHandle = std::coroutine_handle<promise_type>;
+    CoroHandle handle;
+    RunLoop::Operation startOperation;
+
+public:
+    explicit SyncWaitEvent(CoroHandle coroutine) noexcept
+        : handle(coroutine)
+    {}
+
+    SyncWaitEvent(const SyncWaitEvent&) = delete;
+    SyncWaitEvent& operator=(const SyncWaitEvent&) = delete;
+
+    ~SyncWaitEvent()
+    {
+        if (handle) handle.destroy();
+    }
+
+    void start(RunLoop& loop)
+    {
+        handle.promise().loop = &loop;
+        startOperation.handle = handle;
+        loop.post(startOperation);
+    }
+};
+
+/**
+ * @brief Blocks the calling thread until the task completes, even if the task
+ *        suspends and is woken up by other threads (unlike startTask()).
+ *        The calling thread drives a RunLoop meanwhile, so coroutines that park
+ *        on it (e.g. in a Channel) are resumed on the calling thread.
+ * @returns Result of the task, rethrows its exception
+ */
+template<typename T>
+T syncWait(Task<T>&& task)
+{
+    auto waitFor = [](Task<T>& t) -> SyncWaitEvent {
+        co_await t.when_ready();
+    };
+
+    RunLoop loop;
+    auto event = waitFor(task);
+    event.start(loop);
+    loop.run();
+
+    if constexpr (std::is_void_v<T>)
+    {
+        startTask(std::move(task));
+    }
+    else
+    {
+        return startTask(std::move(task)).result();
+    }
+}
@@ -272,7 +272,23 @@ public:
 
         return awaitable { handle };
     }
-    
+
+    /**
+     * @brief Waits for the task to complete without fetching its result,
+     *        so a failed task does not rethrow into the awaiting coroutine
+     */
+    auto when_ready() const noexcept
+    {
+        struct awaitable : awaitable_base
+        {
+            using awaitable_base::awaitable_base;
+
+            void await_resume() const noexcept {}
+        };
+
+        return awaitable { handle };
+    }
+
 };
 
 
@@ -0,0 +1,423 @@
+#pragma once
+#include "ConcurrentQueue.h"
+#include "CpuAffinity.h"
+#include "util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <coroutine>
+#include <cstddef> // size_t, ptrdiff_t
+#include <exception>
+#include <future>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/** @brief Where the workers of a ThreadPool may run */
+enum class WorkerPlacement
+{
+    Unpinned,   // anywhere, the OS scheduler decides
+    Core,       // one core each, the workers are spread evenly over the NUMA nodes
+    Node,       // any core of one NUMA node, the workers are spread evenly over the nodes
+};
+
+inline const char* toString(WorkerPlacement placement) noexcept
+{
+    switch (placement)
+    {
+        case WorkerPlacement::Unpinned: return "unpinned";
+        case WorkerPlacement::Core:     return "core";
+        case WorkerPlacement::Node:     return "node";
+    }
+    return "?";
+}
+
+/**
+ * @brief Fixed set of worker threads that run submitted jobs, created once and reused.
+ *
+ * Launching a job costs one allocation and a lock-free queue push instead of
+ * creating an OS thread. Idle workers spin briefly, then sleep on an EventCount,
+ * so post() takes no lock unless the bounded queue is full.
+ *
+ * Options::placement pins the workers to cores or NUMA nodes, and every worker
+ * can own a scratch buffer (workerBuffer()) that it allocates itself after
+ * pinning, so the pages end up on its own node. Work reaches the pool three ways:
+ *  - submit(fn) runs one callable, its result comes back through a std::future;
+ *  - bulk_submit(n, fn) runs fn(0) .. fn(n - 1), the workers claim indices in
+ *    chunks, so n tiny tasks cost a handful of queue operations;
+ *  - `co_await pool.schedule()` moves a coroutine onto a worker (see ScheduleOn.h).
+ *
+ * The returned futures are the completion handles. Don't block on them from
+ * inside the pool: a worker waiting for queued work behind it can deadlock.
+ * The destructor runs the queued jobs, then joins the workers.
+ */
+class ThreadPool
+{
+public:
+    /** @brief Queue node, every queued job lives until it has run */
+    struct Job
+    {
+        Job* next = nullptr;
+        virtual void run() noexcept = 0;
+
+    protected:
+        ~Job() = default;
+    };
+
+    struct Options
+    {
+        size_t threadCount = std::thread::hardware_concurrency();
+        WorkerPlacement placement = WorkerPlacement::Unpinned;
+        size_t workerBufferSize = 0; // bytes, see workerBuffer()
+    };
+
+private:
+    static constexpr size_t QUEUE_CAPACITY = 4096;
+    static constexpr int SPIN_COUNT = 64;
+
+    MpmcQueue<Job*> queue {QUEUE_CAPACITY};
+    // jobs that did not fit into the queue, rare enough to take a lock
+    std::mutex overflowMutex;
+    Job* overflowHead = nullptr;
+    Job* overflowTail = nullptr;
+    std::atomic<size_t> overflowCount {0};
+    EventCount idle;
+    std::atomic<bool> stopping {false};
+    std::vector<std::thread> workers;
+    std::vector<NumaNode> nodes;
+    WorkerPlacement workerPlacement;
+    std::atomic<size_t> pinned {0};
+    std::atomic<size_t> idleWorkers {0};
+
+    static inline thread_local const ThreadPool* currentPool = nullptr;
+    static inline thread_local std::span<std::byte> currentBuffer;
+
+    struct ScheduleAwaitable : Job
+    {
+        ThreadPool& pool;
+        std::coroutine_handle<> handle;
+
+        explicit ScheduleAwaitable(ThreadPool& p) noexcept : pool {p} {}
+
+        bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> coro) noexcept
+        {
+            handle = coro;
+            pool.post(*this);
+        }
+
+        void await_resume() const noexcept {}
+
+        void run() noexcept override { handle.resume(); }
+    };
+
+    Job* tryTake() noexcept
+    {
+        if (auto job = queue.tryPop())
+            return *job;
+        if (overflowCount.load(std::memory_order_relaxed) == 0)
+            return nullptr;
+
+        std::lock_guard lock {overflowMutex};
+        Job* job = overflowHead;
+        if (job)
+        {
+            overflowHead = job->next;
+            if (!overflowHead) overflowTail = nullptr;
+            overflowCount.fetch_sub(1, std::memory_order_relaxed);
+        }
+        return job;
+    }
+
+    /** @returns nullptr once the pool is stopping and no job is left */
+    Job* pop() noexcept
+    {
+        if (Job* job = tryTake())
+            return job; // busy workers skip the idle bookkeeping
+
+        idleWorkers.fetch_add(1, std::memory_order_relaxed);
+        Job* job = waitForJob();
+        idleWorkers.fetch_sub(1, std::memory_order_relaxed);
+        return job;
+    }
+
+    Job* waitForJob() noexcept
+    {
+        while (true)
+        {
+            for (int i = 0; i < SPIN_COUNT; i++)
+            {
+                if (Job* job = tryTake()) return job;
+                cpuRelax();
+            }
+
+            uint32_t key = idle.prepareWait();
+            if (Job* job = tryTake())
+            {
+                idle.cancelWait(key);
+                return job;
+            }
+            if (stopping.load(std::memory_order_acquire))
+            {
+                idle.cancelWait(key);
+                return nullptr;
+            }
+            idle.wait(key);
+        }
+    }
+
+    void shutdown() noexcept
+    {
+        stopping.store(true, std::memory_order_release);
+        idle.notify();
+        for (auto& w : workers)
+            w.join();
+    }
+
+    /** @returns CPUs worker `index` may run on, empty if it is not pinned */
+    std::vector<unsigned> cpusFor(size_t index, size_t threadCount) const
+    {
+        if (workerPlacement == WorkerPlacement::Unpinned)
+            return {};
+
+        // consecutive workers share a node, so each node gets an even share
+        size_t n = index * nodes.size() / threadCount;
+        const NumaNode& node = nodes[n];
+        if (workerPlacement == WorkerPlacement::Node)
+            return node.cpus;
+
+        size_t firstOnNode = (n * threadCount + nodes.size() - 1) / nodes.size();
+        return { node.cpus[(index - firstOnNode) % node.cpus.size()] };
+    }
+
+    void work(const std::vector<unsigned>& cpus, size_t bufferSize, std::latch& ready)
+    {
+        if (!cpus.empty() && pinCurrentThreadToCpus(cpus))
+            pinned.fetch_add(1, std::memory_order_relaxed);
+
+        // zeroed right after pinning: the kernel places a page on the node
+        // of the thread that touches it first
+        std::unique_ptr<std::byte[]> buffer;
+        if (bufferSize)
+            buffer.reset(new (std::nothrow) std::byte[bufferSize]());
+        currentBuffer = { buffer.get(), buffer ? bufferSize : 0 };
+        currentPool = this;
+        ready.count_down(); // `ready` is gone after this
+
+        while (Job* job = pop())
+            job->run(); // `job` may be destroyed after this
+        currentBuffer = {};
+        currentPool = nullptr;
+    }
+
+public:
+    explicit ThreadPool(size_t threadCount = std::thread::hardware_concurrency())
+    : ThreadPool(Options { threadCount })
+    {}
+
+    explicit ThreadPool(const Options& options)
+    : nodes { numaNodes() }
+    , workerPlacement { options.placement }
+    {
+        size_t threadCount = std::max<size_t>(options.threadCount, 1);
+        std::latch ready { static_cast<std::ptrdiff_t>(threadCount) };
+        workers.reserve(threadCount);
+        try
+        {
+            for (size_t i = 0; i < threadCount; i++)
+                workers.emplace_back([this, &ready, cpus = cpusFor(i, threadCount), size = options.workerBufferSize] {
+                    work(cpus, size, ready);
+                });
+            ready.wait(); // so that pinnedCount() is final
+        }
+        catch (...)
+        {
+            shutdown();
+            throw;
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() { shutdown(); }
+
+    size_t threadCount() const noexcept { return workers.size(); }
+
+    WorkerPlacement placement() const noexcept { return workerPlacement; }
+
+    size_t nodeCount() const noexcept { return nodes.size(); }
+
+    /** @returns Number of workers waiting for a job, a snapshot that may be stale at once */
+    size_t idleCount() const noexcept { return idleWorkers.load(std::memory_order_relaxed); }
+
+    /** @returns true if the calling thread is one of this pool's workers */
+    bool isWorkerThread() const noexcept { return currentPool == this; }
+
+    /** @returns Number of workers the OS actually pinned, 0 when unpinned */
+    size_t pinnedCount() const noexcept { return pinned.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Scratch memory of the calling worker, e.g. for copying, allocated
+     *        on the worker's own NUMA node
+     * @returns Empty span outside of pool workers or if Options::workerBufferSize is 0
+     */
+    static std::span<std::byte> workerBuffer() noexcept { return currentBuffer; }
+
+    /** @brief Suspends the awaiting coroutine and resumes it on a worker */
+    [[nodiscard]] ScheduleAwaitable schedule() noexcept { return ScheduleAwaitable { *this }; }
+
+    /** @brief Queues a job, `job` must stay alive until it has run */
+    void post(Job& job) noexcept
+    {
+        if (!queue.tryPush(&job))
+        {
+            std::lock_guard lock {overflowMutex};
+            job.next = nullptr;
+            if (overflowTail) overflowTail->next = &job;
+            else              overflowHead = &job;
+            overflowTail = &job;
+            overflowCount.fetch_add(1, std::memory_order_relaxed);
+        }
+        idle.notifyOne(); // one job needs one worker
+    }
+
+    /**
+     * @brief Runs `fn` on a worker
+     * @returns Completion handle with the result or the exception thrown by `fn`
+     */
+    template<typename F>
+    std::future<std::invoke_result_t<F&>> submit(F fn)
+    {
+        using R = std::invoke_result_t<F&>;
+
+        struct FunctionJob final : Job
+        {
+            F fn;
+            std::promise<R> promise;
+
+            explicit FunctionJob(F&& f) : fn {std::move(f)} {}
+
+            void run() noexcept override
+            {
+                // the job and what `fn` captured are freed before the result is
+                // published, a waiter that wakes up on it sees them gone already
+                std::promise<R> done = std::move(promise);
+                auto call = [this]() -> R
+                {
+                    std::unique_ptr<FunctionJob> self {this};
+                    return self->fn();
+                };
+                try
+                {
+                    if constexpr (std::is_void_v<R>)
+                    {
+                        call();
+                        done.set_value();
+                    }
+                    else
+                    {
+                        done.set_value(call());
+                    }
+                }
+                catch (...)
+                {
+                    done.set_exception(std::current_exception());
+                }
+            }
+        };
+
+        auto job = std::make_unique<FunctionJob>(std::move(fn));
+        auto future = job->promise.get_future();
+        post(*job.release());
+        return future;
+    }
+
+    /**
+     * @brief Runs fn(0), ..., fn(n - 1) on the workers, in no particular order
+     * @returns Completion handle, ready once every call has returned;
+     *          holds the first exception thrown, the remaining calls are skipped then
+     */
+    template<typename F>
+    std::future<void> bulk_submit(size_t n, F fn)
+    {
+        struct Bulk;
+
+        struct Helper final : Job
+        {
+            Bulk* bulk = nullptr;
+            void run() noexcept override { bulk->work(); }
+        };
+
+        struct Bulk
+        {
+            F fn;
+            size_t n;
+            size_t chunk;
+            std::atomic<size_t> next {0};
+            std::atomic<size_t> running;
+            std::atomic<bool> failed {false};
+            std::exception_ptr error;
+            std::promise<void> promise;
+            std::vector<Helper> helpers;
+
+            Bulk(F&& f, size_t n, size_t helperCount)
+            : fn {std::move(f)}, n {n}, chunk {std::max<size_t>(n / (helperCount * 4), 1)},
+              running {helperCount}, helpers(helperCount)
+            {
+                for (auto& h : helpers)
+                    h.bulk = this;
+            }
+
+            void work() noexcept
+            {
+                try
+                {
+                    size_t begin;
+                    while ((begin = next.fetch_add(chunk, std::memory_order_relaxed)) < n)
+                        for (size_t i = begin, end = std::min(begin + chunk, n); i < end; i++)
+                            fn(i);
+                }
+                catch (...)
+                {
+                    if (!failed.exchange(true))
+                        error = std::current_exception();
+                    next.store(n, std::memory_order_relaxed); // skip what is left
+                }
+
+                // the last helper to finish publishes the result and frees the state
+                if (running.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    std::promise<void> done = std::move(promise);
+                    std::exception_ptr failure = std::move(error);
+                    delete this;
+                    if (failure) done.set_exception(std::move(failure));
+                    else         done.set_value();
+                }
+            }
+        };
+
+        if (n == 0)
+        {
+            std::promise<void> done;
+            done.set_value();
+            return done.get_future();
+        }
+
+        auto bulk = std::make_unique<Bulk>(std::move(fn), n, std::min(n, workers.size()));
+        auto future = bulk->promise.get_future();
+        Helper* helpers = bulk->helpers.data();
+        size_t helperCount = bulk->helpers.size();
+        bulk.release(); // owned by the helpers from here on
+        for (size_t i = 0; i < helperCount; i++)
+            post(helpers[i]);
+        return future;
+    }
+};
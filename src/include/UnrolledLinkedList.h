@@ -0,0 +1,312 @@
+#pragma once
+#include "util.h"
+
+#include <algorithm>
+#include <cstddef> // size_t, byte
+#include <cstdint> // uint32_t
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace detail
+{
+    /** @returns How many `T` fit into a node of about two cache lines, at least 4 */
+    template<typename T>
+    constexpr size_t unrolledNodeCapacity() noexcept
+    {
+        constexpr size_t header = sizeof(void*) + sizeof(uint32_t);
+        return std::max<size_t>(4, (2 * CACHE_LINE_SIZE - header) / sizeof(T));
+    }
+}
+
+/**
+ * @brief Singly linked list that keeps up to `N` elements per node, with the
+ *        interface of SmartPtrLinkedList.
+ *
+ * Iteration walks arrays instead of chasing a pointer per element, and a node
+ * costs one allocation per `N` elements. insertAfter() into a full node splits
+ * it in two halves, eraseAfter() merges a node that got less than a quarter
+ * full into its successor. Both move the elements of the node they touch, so
+ * they invalidate iterators to that node (and to the successor on merges);
+ * iterators to other nodes stay valid.
+ */
+template<typename T, size_t N = detail::unrolledNodeCapacity<T>()>
+class UnrolledLinkedList
+{
+    static_assert(N >= 2, "a node must hold at least two elements to be split");
+
+    struct Node
+    {
+        std::unique_ptr<Node> next;
+        uint32_t count = 0;
+        alignas(T) std::byte storage[N * sizeof(T)];
+
+        Node() noexcept = default;
+        Node(const Node&) = delete;
+        Node& operator=(const Node&) = delete;
+        ~Node() { std::destroy_n(data(), count); }
+
+        T* data() noexcept { return std::launder(reinterpret_cast<T*>(storage)); }
+        T& operator[](size_t i) noexcept { return data()[i]; }
+        bool full() const noexcept { return count == N; }
+
+        /** @brief Constructs the element at `pos`, the elements from `pos` on move one to the right */
+        template<typename... Args>
+        void emplace(size_t pos, Args&&... args)
+        {
+            if (pos == count)
+            {
+                std::construct_at(data() + count, std::forward<Args>(args)...);
+            }
+            else
+            {
+                T value(std::forward<Args>(args)...); // may alias an element we are about to move
+                std::construct_at(data() + count, std::move(data()[count - 1]));
+                std::move_backward(data() + pos, data() + count - 1, data() + count);
+                data()[pos] = std::move(value);
+            }
+            count++;
+        }
+
+        void erase(size_t pos) noexcept
+        {
+            std::move(data() + pos + 1, data() + count, data() + pos);
+            std::destroy_at(data() + --count);
+        }
+
+        /** @brief Moves the elements from `pos` on to the front of the empty node `to` */
+        void moveTail(size_t pos, Node& to) noexcept
+        {
+            std::uninitialized_move(data() + pos, data() + count, to.data() + to.count);
+            to.count += count - pos;
+            std::destroy(data() + pos, data() + count);
+            count = static_cast<uint32_t>(pos);
+        }
+    };
+
+    std::unique_ptr<Node> head;
+    size_t length = 0;
+
+    /** @brief Makes `node` have room for one more element, @returns the node `pos` ended up in */
+    std::pair<Node*, size_t> makeRoom(Node* node, size_t pos)
+    {
+        if (!node->full()) return { node, pos };
+        auto half = std::make_unique<Node>();
+        node->moveTail(N / 2, *half);
+        half->next = std::move(node->next);
+        node->next = std::move(half);
+        if (pos <= node->count) return { node, pos };
+        return { node->next.get(), pos - node->count };
+    }
+
+    /** @brief Moves the successor of `node` into it, if both fit into one node */
+    void mergeNext(Node* node) noexcept
+    {
+        Node* next = node->next.get();
+        if (!next || node->count + next->count > N) return;
+        next->moveTail(0, *node);
+        node->next = std::move(next->next);
+    }
+
+    template<typename Container>
+    void copy(const Container& other)
+    {
+        std::unique_ptr<Node>* tail = &head;
+        Node* last = nullptr;
+        for (const T& value : other)
+        {
+            if (!last || last->full())
+            {
+                *tail = std::make_unique<Node>();
+                last = tail->get();
+                tail = &last->next;
+            }
+            last->emplace(last->count, value);
+            length++;
+        }
+    }
+
+public:
+    UnrolledLinkedList() noexcept = default;
+    ~UnrolledLinkedList() noexcept { clear(); }
+
+    UnrolledLinkedList(std::initializer_list<T> inlist) { copy(inlist); }
+    UnrolledLinkedList(const UnrolledLinkedList& other) { copy(other); }
+
+    UnrolledLinkedList& operator=(const UnrolledLinkedList& other)
+    {
+        if (this != &other)
+        {
+            clear();
+            copy(other);
+        }
+        return *this;
+    }
+
+    UnrolledLinkedList(UnrolledLinkedList&& other) noexcept
+    : head(std::move(other.head))
+    , length(std::exchange(other.length, 0))
+    {}
+
+    UnrolledLinkedList& operator=(UnrolledLinkedList&& other) noexcept
+    {
+        clear();
+        head = std::move(other.head);
+        length = std::exchange(other.length, 0);
+        return *this;
+    }
+
+    static constexpr size_t nodeCapacity() noexcept { return N; }
+
+    T&       front()       { return (*head)[0]; }
+    const T& front() const { return (*head)[0]; }
+
+    bool empty() const noexcept { return length == 0; }
+    size_t size() const noexcept { return length; }
+
+    void clear() noexcept
+    {
+        while (head)
+            head = std::move(head->next); // iterative, a long chain would overflow the stack
+        length = 0;
+    }
+
+    template<bool constiter>
+    class IteratorT
+    {
+        friend class UnrolledLinkedList;
+        template<bool> friend class IteratorT;
+
+        Node* node = nullptr;
+        size_t index = 0;
+
+        IteratorT(Node* node, size_t index) noexcept : node {node}, index {index} {}
+    public:
+        using DereferenceType = std::conditional_t<constiter, const T&, T&>;
+
+        IteratorT() noexcept = default;
+
+        template<bool b, typename = std::enable_if_t<constiter || !b>>
+        IteratorT(const IteratorT<b>& other) noexcept : node {other.node}, index {other.index} {}
+
+        DereferenceType operator*() const { return (*node)[index]; }
+        std::remove_reference_t<DereferenceType>* operator->() const { return &(*node)[index]; }
+
+        IteratorT& operator++() noexcept
+        {
+            if (++index == node->count)
+            {
+                node = node->next.get();
+                index = 0;
+            }
+            return *this;
+        }
+
+        operator bool() const noexcept { return node != nullptr; }
+
+        template<bool b>
+        bool operator==(const IteratorT<b>& other) const noexcept
+        {
+            return node == other.node && index == other.index;
+        }
+
+        template<bool b>
+        bool operator !=(const IteratorT<b>& other) const noexcept
+        {
+            return !(*this == other);
+        }
+    };
+
+    using Iterator = IteratorT<false>;
+    using ConstIterator = IteratorT<true>;
+
+    Iterator         begin()         noexcept { return { head.get(), 0 }; }
+    Iterator         end()           noexcept { return {}; }
+    ConstIterator    begin() const   noexcept { return { head.get(), 0 }; }
+    ConstIterator    end()   const   noexcept { return {}; }
+    ConstIterator    cbegin()const   noexcept { return { head.get(), 0 }; }
+    ConstIterator    cend()  const   noexcept { return {}; }
+
+    /** @returns Iterator to the inserted element */
+    template<bool b, typename... Args>
+    IteratorT<b> emplaceAfter(IteratorT<b> it, Args&&... args)
+    {
+        auto [node, pos] = makeRoom(it.node, it.index + 1);
+        node->emplace(pos, std::forward<Args>(args)...);
+        length++;
+        return { node, pos };
+    }
+
+    template<bool b>
+    IteratorT<b> insertAfter(IteratorT<b> it, const T& value) { return emplaceAfter(it, value); }
+
+    template<bool b>
+    IteratorT<b> insertAfter(IteratorT<b> it, T&& value) { return emplaceAfter(it, std::move(value)); }
+
+    /** @returns Iterator to the element that followed the erased one */
+    template<bool b>
+    IteratorT<b> eraseAfter(IteratorT<b> it)
+    {
+        Node* node = it.node;
+        size_t pos = it.index + 1;
+        if (pos == node->count)
+        {
+            node = node->next.get();
+            pos = 0;
+        }
+        node->erase(pos);
+        length--;
+        if (node->count == 0)
+        {
+            Node* next = node->next.get();
+            it.node->next = std::move(node->next); // `node` follows `it.node` and dies here
+            return { next, 0 };
+        }
+        if (node->count < N / 4)
+            mergeNext(node);
+        if (pos == node->count)
+            return { node->next.get(), 0 };
+        return { node, pos };
+    }
+
+    template<typename... Args>
+    void emplaceFront(Args&&... args)
+    {
+        if (!head || head->full())
+        {
+            auto node = std::make_unique<Node>();
+            node->next = std::move(head);
+            head = std::move(node);
+        }
+        head->emplace(0, std::forward<Args>(args)...);
+        length++;
+    }
+
+    void pushFront(const T& value) { emplaceFront(value); }
+    void pushFront(T&& value) { emplaceFront(std::move(value)); }
+
+    void popFront()
+    {
+        head->erase(0);
+        length--;
+        if (head->count == 0)
+            head = std::move(head->next);
+    }
+};
+
+template<typename T, size_t N>
+bool operator==(const UnrolledLinkedList<T, N>& lhs, const UnrolledLinkedList<T, N>& rhs) noexcept
+{
+    if (lhs.size() != rhs.size()) return false;
+    for (auto it1 = lhs.cbegin(), it2 = rhs.cbegin(); it1; ++it1, ++it2)
+        if (*it1 != *it2) return false;
+    return true;
+}
+
+template<typename T, size_t N>
+bool operator!=(const UnrolledLinkedList<T, N>& lhs, const UnrolledLinkedList<T, N>& rhs) noexcept
+{
+    return !(lhs == rhs);
+}
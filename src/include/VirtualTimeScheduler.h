@@ -0,0 +1,204 @@
+#pragma once
+#include "Task.h"
+
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <queue>
+#include <utility>
+
+/**
+ * @brief Single-threaded executor with a virtual clock for deterministic simulations.
+ *
+ * Coroutines are resumed in a fixed order: ready coroutines FIFO, then timers
+ * by (deadline, insertion order). Time only advances when nothing is ready,
+ * jumping straight to the next deadline, so sleeping costs no wall time and
+ * two runs of the same scenario produce exactly the same timeline.
+ */
+class VirtualTimeScheduler
+{
+public:
+    using duration = std::chrono::nanoseconds;
+
+    /** @brief Virtual clock, starts at zero for every scheduler */
+    struct time_point
+    {
+        duration sinceStart {0};
+
+        friend auto operator<=>(const time_point&, const time_point&) = default;
+        friend time_point operator+(time_point t, duration d) noexcept { return { t.sinceStart + d }; }
+        friend duration operator-(time_point a, time_point b) noexcept { return a.sinceStart - b.sinceStart; }
+    };
+
+private:
+    struct Timer
+    {
+        time_point deadline;
+        uint64_t sequence;
+        std::coroutine_handle<> handle;
+
+        // std::priority_queue is a max-heap
+        bool operator<(const Timer& other) const noexcept
+        {
+            if (deadline != other.deadline) return deadline > other.deadline;
+            return sequence > other.sequence;
+        }
+    };
+
+    /** @brief Detached wrapper of a spawned task, destroys itself once the task is done */
+    struct Spawned
+    {
+        struct promise_type
+        {
+            VirtualTimeScheduler* scheduler = nullptr;
+            promise_type* prev = nullptr;
+            promise_type* next = nullptr;
+
+            ~promise_type()
+            {
+                if (scheduler) scheduler->unlink(this);
+            }
+
+            Spawned get_return_object() noexcept
+            {
+                return { std::coroutine_handle<promise_type>::from_promise(*this) };
+            }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() noexcept {}
+            void unhandled_exception() noexcept
+            {
+                if (!scheduler->failure) scheduler->failure = std::current_exception();
+            }
+        };
+
+        std::coroutine_handle<promise_type> handle;
+    };
+    using SpawnedPromise = Spawned::promise_type;
+
+    time_point current;
+    uint64_t nextSequence = 0;
+    std::deque<std::coroutine_handle<>> ready;
+    std::priority_queue<Timer> timers;
+    SpawnedPromise* spawned = nullptr; // intrusive list of unfinished spawned tasks
+    std::exception_ptr failure;
+
+    static Spawned wrap(Task<> task)
+    {
+        co_await task;
+    }
+
+    void link(SpawnedPromise* p) noexcept
+    {
+        p->scheduler = this;
+        p->next = spawned;
+        if (spawned) spawned->prev = p;
+        spawned = p;
+    }
+
+    void unlink(SpawnedPromise* p) noexcept
+    {
+        if (p->prev) p->prev->next = p->next;
+        else         spawned = p->next;
+        if (p->next) p->next->prev = p->prev;
+    }
+
+    struct ScheduleAwaitable
+    {
+        VirtualTimeScheduler& scheduler;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> coro) { scheduler.ready.push_back(coro); }
+        void await_resume() const noexcept {}
+    };
+
+    struct SleepAwaitable
+    {
+        VirtualTimeScheduler& scheduler;
+        time_point deadline;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> coro)
+        {
+            scheduler.timers.push({ deadline, scheduler.nextSequence++, coro });
+        }
+        void await_resume() const noexcept {}
+    };
+
+public:
+    VirtualTimeScheduler() noexcept = default;
+    VirtualTimeScheduler(const VirtualTimeScheduler&) = delete;
+    VirtualTimeScheduler& operator=(const VirtualTimeScheduler&) = delete;
+
+    ~VirtualTimeScheduler()
+    {
+        // tasks still waiting for a timer or for another coroutine
+        while (spawned)
+            std::coroutine_handle<SpawnedPromise>::from_promise(*spawned).destroy();
+    }
+
+    time_point now() const noexcept { return current; }
+
+    /** @brief Re-queues the awaiting coroutine behind the ready ones, without advancing time */
+    [[nodiscard]] ScheduleAwaitable schedule() noexcept { return { *this }; }
+
+    /** @brief Resumes the awaiting coroutine once the virtual clock reaches `deadline` */
+    [[nodiscard]] SleepAwaitable sleepUntil(time_point deadline) noexcept
+    {
+        return { *this, deadline < current ? current : deadline };
+    }
+
+    [[nodiscard]] SleepAwaitable sleepFor(duration d) noexcept { return sleepUntil(current + d); }
+
+    /** @brief Runs the task on this scheduler, it is started by the next run() */
+    void spawn(Task<> task)
+    {
+        auto s = wrap(std::move(task));
+        link(&s.handle.promise());
+        ready.push_back(s.handle);
+    }
+
+    /**
+     * @brief Resumes ready coroutines and fires timers until nothing is left to do
+     *        or the clock would pass `limit`
+     * @returns Number of coroutines resumed
+     * @throws The first exception escaping a spawned task
+     */
+    size_t runUntil(time_point limit)
+    {
+        size_t resumed = 0;
+        while (true)
+        {
+            while (!ready.empty())
+            {
+                auto coro = ready.front();
+                ready.pop_front();
+                coro.resume();
+                resumed++;
+            }
+
+            if (timers.empty() || timers.top().deadline > limit)
+                break;
+
+            current = timers.top().deadline;
+            while (!timers.empty() && timers.top().deadline == current)
+            {
+                ready.push_back(timers.top().handle);
+                timers.pop();
+            }
+        }
+
+        if (failure) std::rethrow_exception(std::exchange(failure, nullptr));
+        return resumed;
+    }
+
+    size_t run() { return runUntil({ duration::max() }); }
+
+    /** @returns true if there are no ready coroutines and no pending timers */
+    bool idle() const noexcept { return ready.empty() && timers.empty(); }
+
+    /** @returns true if all spawned tasks have finished */
+    bool done() const noexcept { return !spawned; }
+};
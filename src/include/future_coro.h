@@ -90,16 +90,16 @@ struct awaiter : std::future<T>
         std::future<T>::operator=(p.get_future());
         std::thread t(
             [cont] (std::future<T>&& f, std::promise<T>&& p) { // TODO is it safe to move?
+                // publish the result before resuming: await_resume() reads it
                 try
                 {
-                    auto result = f.get();
-                    cont.resume();
-                    p.set_value(result);
+                    p.set_value(f.get());
                 }
                 catch(...)
                 {
                     p.set_exception(std::current_exception());
                 }
+                cont.resume();
             }, std::move(me), std::move(p)
         );
         t.detach();
@@ -145,16 +145,17 @@ public:
         std::future<void>::operator=(p.get_future());
         std::thread t(
             [cont] (std::future<void>&& f, std::promise<void>&& p) { // TODO is it safe to move?
+                // publish the result before resuming: await_resume() reads it
                 try
                 {
                     f.get();
-                    cont.resume();
                     p.set_value();
                 }
                 catch(...)
                 {
                     p.set_exception(std::current_exception());
                 }
+                cont.resume();
             }, std::move(me), std::move(p)
         );
         t.detach();
@@ -3,11 +3,11 @@
 #if LOG_LEVEL >= 1
 #define LogInfo(fmt, ...) printf(fmt "\n", ##__VA_ARGS__)
 #else
-#define LogInfo(fmt, ...)
+#define LogInfo(fmt, ...) ((void)0)
 #endif
 
 #if LOG_LEVEL >= 2
 #define LogError(fmt, ...) fprintf(stderr, fmt "\n", ##__VA_ARGS__)
 #else 
-#define LogError(fmt, ...)
+#define LogError(fmt, ...) ((void)0)
 #endif
\ No newline at end of file
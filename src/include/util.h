@@ -1,8 +1,28 @@
 #pragma once
 
 #include <string>
+#include <cstddef> // size_t
 
-std::string getProjectPath() noexcept
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h> // _mm_pause
+#endif
+
+// std::hardware_destructive_interference_size is not stable across compilers
+inline constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+/** @brief Spin-wait hint: lets the sibling hyperthread run and saves power while polling */
+inline void cpuRelax() noexcept
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+inline std::string getProjectPath() noexcept
 {
     return PROJECT_PATH;
 }
@@ -29,7 +29,8 @@ void useAsync(const std::string& path, const std::string& pattern)
     LogInfo("======== Using async");
     try
     {
-	    kw::FTPExampleAsync ftp;
+	    ThreadPool pool {1};
+	    kw::FTPExampleAsync ftp {pool};
 	    auto fileF = ftp.downloadFirstMatch(path,
 			[&pattern](std::string_view f) { return f.ends_with(pattern); },
 	        [](int progress) { LogInfo("Download: %d%%", progress); });
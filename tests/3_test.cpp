@@ -1,5 +1,6 @@
 #include "gtest/gtest.h"
 #include "3_moving_to_modern_cpp.h"
+#include "Memoized.h"
 #include <memory>
 #include <concepts>
 #include <vector>
@@ -9,6 +10,8 @@
 #include <chrono>
 #include <future>
 #include <functional>
+#include <atomic>
+#include <stdexcept>
 
 using ILT = InitializerListTester;
 
@@ -301,6 +304,156 @@ TEST(C3_modern_cpp_Item16, WorksCorrectlyWithMutex)
     EXPECT_EQ(secondResult, expected);
 }
 
+TEST(C3_modern_cpp_Item16, WorksCorrectlyWithConcurrentLazy)
+{
+    const int base = 2;
+    const int power = 5;
+    const CashedPower cpower {base, power};
+    const int expected = std::pow(base, power);
+    std::promise<int> firstPromise;
+    std::promise<int> secondPromise;
+
+    std::thread([&firstPromise, &cpower]{
+        int result = cpower.lockFree();
+        firstPromise.set_value(result);
+    }).detach();
+
+    std::thread([&secondPromise, &cpower]{
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        int result = cpower.lockFree();
+        secondPromise.set_value(result);
+    }).detach();
+
+    int firstResult = firstPromise.get_future().get();
+    int secondResult = secondPromise.get_future().get();
+
+    EXPECT_EQ(cpower.timesComputed(), 1);
+    EXPECT_EQ(firstResult, expected);
+    EXPECT_EQ(secondResult, expected);
+}
+
+TEST(C3_modern_cpp_Item16, LazyComputesOnFirstGetOnly)
+{
+    int calls = 0;
+    Lazy lazy {[&calls] { return std::string(++calls, 'x'); }};
+    EXPECT_FALSE(lazy.isComputed());
+    EXPECT_EQ(lazy.get(), "x");
+    EXPECT_EQ(lazy.get(), "x");
+    EXPECT_TRUE(lazy.isComputed());
+    EXPECT_EQ(calls, 1);
+}
+
+TEST(C3_modern_cpp_Item16, ConcurrentLazyComputesOnceAcrossThreads)
+{
+    std::atomic<int> calls {0};
+    ConcurrentLazy lazy {[&calls] {
+        calls++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        return 42;
+    }};
+
+    std::vector<std::thread> threads;
+    std::atomic<int> correct {0};
+    for (int i = 0; i < 8; i++)
+        threads.emplace_back([&] { correct += lazy.get() == 42; });
+    for (auto& t : threads)
+        t.join();
+
+    EXPECT_EQ(calls, 1);
+    EXPECT_EQ(correct, 8);
+    EXPECT_TRUE(lazy.isComputed());
+}
+
+TEST(C3_modern_cpp_Item16, ConcurrentLazyRetriesAfterException)
+{
+    int calls = 0;
+    ConcurrentLazy<int> lazy {[&calls] {
+        if (++calls == 1) throw std::runtime_error("first try fails");
+        return 7;
+    }};
+    EXPECT_THROW(lazy.get(), std::runtime_error);
+    EXPECT_FALSE(lazy.isComputed());
+    EXPECT_EQ(lazy.get(), 7);
+    EXPECT_EQ(calls, 2);
+}
+
+TEST(C3_modern_cpp_Item16, MemoizedCachesPerArguments)
+{
+    std::atomic<int> calls {0};
+    Memoized power {[&calls](int base, int exp) { calls++; return static_cast<int>(std::pow(base, exp)); }};
+    EXPECT_EQ(power(2, 5), 32);
+    EXPECT_EQ(power(2, 5), 32);
+    EXPECT_EQ(power(3, 2), 9);
+    EXPECT_EQ(calls, 2);
+
+    auto stats = power.stats();
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.misses, 2u);
+    EXPECT_EQ(stats.size, 2u);
+}
+
+TEST(C3_modern_cpp_Item16, MemoizedEvictsWithClock)
+{
+    std::vector<int> computed;
+    Memoized<int(int)> square {[&computed](int x) { computed.push_back(x); return x * x; }, 4, 1};
+    ASSERT_EQ(square.capacity(), 4u);
+    for (int x = 0; x < 4; x++)
+        square(x);
+
+    square(10); // every entry is new: the hand clears all bits and comes back to 0
+    square(2);  // a hit gives 2 a second chance
+    square(11); // evicts 1
+    square(12); // skips 2, evicts 3
+    computed.clear();
+    for (int x : { 2, 10, 11, 12 })
+        EXPECT_EQ(square(x), x * x);
+    EXPECT_TRUE(computed.empty());
+
+    square(0);
+    square(1);
+    EXPECT_EQ(computed, (std::vector<int>{ 0, 1 }));
+    auto stats = square.stats();
+    EXPECT_EQ(stats.evictions, 5u);
+    EXPECT_EQ(stats.size, 4u);
+}
+
+TEST(C3_modern_cpp_Item16, MemoizedComputesConcurrentMissesOnce)
+{
+    std::atomic<int> calls {0};
+    Memoized<int(int)> slow {[&calls](int x) {
+        calls++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        return x + 1;
+    }};
+
+    std::vector<std::thread> threads;
+    std::atomic<int> correct {0};
+    for (int i = 0; i < 8; i++)
+        threads.emplace_back([&] { correct += slow(41) == 42; });
+    for (auto& t : threads)
+        t.join();
+
+    EXPECT_EQ(calls, 1);
+    EXPECT_EQ(correct, 8);
+    auto stats = slow.stats();
+    EXPECT_EQ(stats.misses, 1u);
+    EXPECT_EQ(stats.hits + stats.joins, 7u);
+}
+
+TEST(C3_modern_cpp_Item16, MemoizedDoesNotCacheFailures)
+{
+    int calls = 0;
+    Memoized<std::string(const std::string&)> upper {[&calls](const std::string& s) {
+        if (++calls == 1) throw std::runtime_error("first try fails");
+        return s + "!";
+    }};
+    EXPECT_THROW(upper("hi"), std::runtime_error);
+    EXPECT_EQ(upper.stats().size, 0u);
+    EXPECT_EQ(upper("hi"), "hi!");
+    EXPECT_EQ(upper("hi"), "hi!");
+    EXPECT_EQ(calls, 2);
+}
+
 TEST(C3_modern_cpp_Item17, DefinesCopyAssignmentIfCopyCtorIsUserDefined)
 {
     CopyableConstructor c1;
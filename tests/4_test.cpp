@@ -2,6 +2,18 @@
 #include "gtest/gtest.h"
 #include "MemoryLeakDetector.h"
 
+#include <algorithm>
+#include <list>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <ranges>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
 TEST(C4_smart_ptrs_LinkedList, DefaultCtor)
 {
     MemoryLeakDetector d;
@@ -107,6 +119,388 @@ TEST(C4_smart_ptrs_LinkedList, CorrectlyCopiesAndAssignes)
     EXPECT_TRUE(list1.empty());
 }
 
+TEST(C4_smart_ptrs_LinkedList, StdAllocatorListBehavesTheSame)
+{
+    MemoryLeakDetector d;
+    using List = SmartPtrLinkedList<int, std::allocator<int>>;
+    List list {1,2,3};
+    list.pushFront(0);
+    list.insertAfter(list.begin(), 5);
+    List expected {0,5,1,2,3};
+    EXPECT_EQ(list, expected);
+    List moved = std::move(list);
+    EXPECT_EQ(moved, expected);
+    EXPECT_TRUE(list.empty());
+}
+
+TEST(C4_smart_ptrs_LinkedList, NodePoolReusesFreedNodes)
+{
+    MemoryLeakDetector d;
+    NodePoolAllocator<int> alloc;
+    int* a = alloc.allocate(1);
+    int* b = alloc.allocate(1);
+    EXPECT_NE(a, b);
+    alloc.deallocate(a, 1);
+    EXPECT_EQ(alloc.allocate(1), a);
+
+    NodePoolAllocator<int> copy = alloc;
+    EXPECT_TRUE(copy == alloc);
+    EXPECT_FALSE(NodePoolAllocator<int>{} == alloc);
+
+    int* array = alloc.allocate(3); // arrays bypass the pool
+    alloc.deallocate(array, 3);
+    alloc.deallocate(a, 1);
+    alloc.deallocate(b, 1);
+}
+
+TEST(C4_smart_ptrs_LinkedList, PoolOutlivesListWhileIteratorsRemain)
+{
+    MemoryLeakDetector d;
+    using List = SmartPtrLinkedList<int, NodePoolAllocator<int>, true>;
+    List::Iterator it;
+    {
+        List list {1,2,3};
+        it = list.begin();
+        EXPECT_TRUE(it);
+    }
+    // the control block of the first node still lives in the pool
+    EXPECT_FALSE(it);
+}
+
+TEST(C4_smart_ptrs_LinkedList, MovedListTakesThePoolAlong)
+{
+    MemoryLeakDetector d;
+    NodePoolAllocator<int> alloc;
+    int* p = alloc.allocate(1);
+    NodePoolAllocator<int> moved = std::move(alloc);
+    EXPECT_FALSE(moved == alloc);
+    moved.deallocate(p, 1);
+    int* q = alloc.allocate(1); // a new pool of its own
+    EXPECT_FALSE(moved == alloc);
+    alloc.deallocate(q, 1);
+
+    // nothing is shared, so the lists may go on in two threads
+    SmartPtrLinkedList<int> list {1,2,3};
+    std::thread worker([other = std::move(list)]() mutable
+    {
+        for (int i = 0; i < 1000; i++) other.pushFront(i);
+        EXPECT_EQ(other.size(), 1003);
+    });
+    for (int i = 0; i < 1000; i++) list.pushFront(i);
+    list.clear();
+    worker.join();
+}
+
+TEST(C4_smart_ptrs_LinkedList, PoolIsCreatedOnFirstNodeAndFreedByClear)
+{
+    MemoryLeakDetector d;
+    using List = SmartPtrLinkedList<int, NodePoolAllocator<int>, true>;
+    EXPECT_TRUE(allocatesAtMost(0, [] { List empty; }));
+
+    List list {1,2,3};
+    List::Iterator it = list.begin();
+    {
+        AllocationTracker tracker;
+        list.clear(); // the iterator's node keeps the pool
+        EXPECT_EQ(tracker.stats().deallocations, 0);
+    }
+    it = {};
+    list.pushFront(1);
+    AllocationTracker tracker;
+    list.clear();
+    EXPECT_LT(tracker.stats().liveBytes, 0) << "the slabs go back";
+}
+
+TEST(C4_smart_ptrs_LinkedList, IteratorsAreAssignableAndHaveArrow)
+{
+    MemoryLeakDetector d;
+    struct Point { int x, y; };
+    SmartPtrLinkedList<Point> list {{1, 2}, {3, 4}};
+    SmartPtrLinkedList<Point>::Iterator it;
+    EXPECT_EQ(it, list.end());
+    it = list.begin();
+    it->y = 5;
+    ++it;
+    EXPECT_EQ(it->x, 3);
+    EXPECT_EQ(list.front().y, 5);
+}
+
+TEST(C4_smart_ptrs_LinkedList, CheckedIteratorsThrowOnErasedNodes)
+{
+    MemoryLeakDetector d;
+    SmartPtrLinkedList<int, std::allocator<int>, true> list {1,2,3};
+    auto second = ++list.begin();
+    EXPECT_EQ(*second, 2);
+    list.eraseAfter(list.begin());
+    EXPECT_FALSE(second);
+    EXPECT_THROW(*second, decltype(list)::bad_iterator);
+    EXPECT_THROW(++second, decltype(list)::bad_iterator);
+    EXPECT_EQ(list.size(), 2);
+}
+
+TEST(C4_smart_ptrs_LinkedList, SizeIsTrackedByEveryChange)
+{
+    MemoryLeakDetector d;
+    SmartPtrLinkedList<int> list {1,2,3};
+    EXPECT_EQ(list.size(), 3);
+    list.pushFront(0);
+    list.insertAfter(list.begin(), 7);
+    EXPECT_EQ(list.size(), 5);
+    list.eraseAfter(list.begin());
+    list.popFront();
+    EXPECT_EQ(list.size(), 3);
+    SmartPtrLinkedList<int> moved = std::move(list);
+    EXPECT_EQ(moved.size(), 3);
+    EXPECT_EQ(list.size(), 0);
+    // move assignment returns the list itself, nothing gets copied
+    EXPECT_TRUE(allocatesAtMost(0, [&] { EXPECT_EQ((list = std::move(moved)).size(), 3); }));
+    EXPECT_EQ(moved.size(), 0);
+    list.clear();
+    EXPECT_EQ(list.size(), 0);
+}
+
+TEST(C4_smart_ptrs_LinkedList, BuildsFromRanges)
+{
+    MemoryLeakDetector d;
+    std::vector<int> values {1,2,3,4};
+    SmartPtrLinkedList<int> list (values.begin(), values.end());
+    EXPECT_EQ(list, (SmartPtrLinkedList<int> {1,2,3,4}));
+    EXPECT_EQ(list.size(), 4);
+
+    std::istringstream numbers {"7 8 9"}; // input iterators, no size up front
+    auto last = list.insertRangeAfter(list.begin(), std::ranges::subrange(
+        std::istream_iterator<int>(numbers), std::istream_iterator<int>()));
+    EXPECT_EQ(*last, 9);
+    EXPECT_EQ(list, (SmartPtrLinkedList<int> {1,7,8,9,2,3,4}));
+    EXPECT_EQ(list.insertRangeAfter(last, std::vector<int> {}), last);
+
+    list.prependRange(std::vector<int> {-1, 0});
+    EXPECT_EQ(list, (SmartPtrLinkedList<int> {-1,0,1,7,8,9,2,3,4}));
+    EXPECT_EQ(list.size(), 9);
+    EXPECT_TRUE(std::equal(list.begin(), list.end(), SmartPtrLinkedList<int>(list.cbegin(), list.cend()).begin()));
+}
+
+TEST(C4_smart_ptrs_LinkedList, SpliceAfterMovesNodes)
+{
+    MemoryLeakDetector d;
+    SmartPtrLinkedList<int> list {1,2,3};
+    SmartPtrLinkedList<int> other {10,20,30};
+    const int* twenty = &*(++other.begin());
+
+    list.spliceAfter(list.begin(), other, other.begin());
+    EXPECT_EQ(list, (SmartPtrLinkedList<int> {1,20,2,3}));
+    EXPECT_EQ(other, (SmartPtrLinkedList<int> {10,30}));
+    EXPECT_EQ(&*(++list.begin()), twenty);
+
+    list.spliceAfter(list.begin(), other);
+    EXPECT_EQ(list, (SmartPtrLinkedList<int> {1,10,30,20,2,3}));
+    EXPECT_TRUE(other.empty());
+    EXPECT_EQ(list.size(), 6);
+    EXPECT_EQ(other.size(), 0);
+}
+
+TEST(C4_smart_ptrs_LinkedList, MergeAndSortRelinkNodes)
+{
+    MemoryLeakDetector d;
+    using Entry = std::pair<int, char>;
+    auto byKey = [](const Entry& a, const Entry& b) { return a.first < b.first; };
+    SmartPtrLinkedList<Entry> list {{3,'a'}, {1,'b'}, {2,'c'}, {1,'d'}};
+    std::vector<const Entry*> before;
+    for (auto& e : list) before.push_back(&e);
+
+    list.sort(byKey);
+    EXPECT_EQ(list, (SmartPtrLinkedList<Entry> {{1,'b'}, {1,'d'}, {2,'c'}, {3,'a'}})); // stable
+    std::vector<const Entry*> after;
+    for (auto& e : list) after.push_back(&e);
+    std::ranges::sort(before);
+    std::ranges::sort(after);
+    EXPECT_EQ(before, after); // the same nodes
+
+    SmartPtrLinkedList<Entry> other {{0,'x'}, {1,'y'}, {4,'z'}};
+    list.merge(other, byKey);
+    EXPECT_EQ(list, (SmartPtrLinkedList<Entry> {{0,'x'}, {1,'b'}, {1,'d'}, {1,'y'}, {2,'c'}, {3,'a'}, {4,'z'}}));
+    EXPECT_TRUE(other.empty());
+    EXPECT_EQ(list.size(), 7);
+}
+
+TEST(C4_smart_ptrs_LinkedList, SortsABigList)
+{
+    MemoryLeakDetector d;
+    std::vector<int> values(300000);
+    uint32_t x = 1;
+    for (int& v : values)
+        v = static_cast<int>((x = x * 1664525 + 1013904223) >> 8);
+    SmartPtrLinkedList<int> list (values.begin(), values.end());
+    list.sort();
+    std::ranges::sort(values);
+    EXPECT_TRUE(std::equal(values.begin(), values.end(), list.begin()));
+}
+
+TEST(C4_smart_ptrs_LinkedList, PersistentCopiesShareNodes)
+{
+    MemoryLeakDetector d;
+    PersistentLinkedList<int> list {2,3,4};
+    PersistentLinkedList<int> snapshot = list;
+    EXPECT_EQ(snapshot.begin(), list.begin());
+
+    list.pushFront(1);
+    snapshot.popFront();
+    EXPECT_EQ(list, (PersistentLinkedList<int> {1,2,3,4}));
+    EXPECT_EQ(snapshot, (PersistentLinkedList<int> {3,4}));
+    EXPECT_EQ(++(++list.begin()), snapshot.begin()); // still the same nodes
+    static_assert(std::is_same_v<decltype(*list.begin()), const int&>);
+}
+
+TEST(C4_smart_ptrs_LinkedList, PersistentChangesCopyTheSharedPath)
+{
+    MemoryLeakDetector d;
+    PersistentLinkedList<int> list {1,2,3,4,5};
+    PersistentLinkedList<int> snapshot = list;
+
+    auto third = ++(++list.begin());
+    auto inserted = list.insertAfter(third, 10);
+    EXPECT_EQ(*inserted, 10);
+    EXPECT_EQ(list, (PersistentLinkedList<int> {1,2,3,10,4,5}));
+    EXPECT_EQ(snapshot, (PersistentLinkedList<int> {1,2,3,4,5}));
+    // the nodes after the change are shared again
+    EXPECT_EQ(++inserted, ++(++(++snapshot.begin())));
+
+    // the path is ours now, changing it again copies nothing
+    auto first = list.begin();
+    list.eraseAfter(first);
+    EXPECT_EQ(list.begin(), first);
+    EXPECT_EQ(list, (PersistentLinkedList<int> {1,3,10,4,5}));
+    EXPECT_EQ(snapshot, (PersistentLinkedList<int> {1,2,3,4,5}));
+
+    snapshot.clear();
+    EXPECT_EQ(list, (PersistentLinkedList<int> {1,3,10,4,5}));
+}
+
+TEST(C4_smart_ptrs_LinkedList, PersistentSnapshotsOfABigList)
+{
+    MemoryLeakDetector d;
+    PersistentLinkedList<int> list;
+    std::vector<PersistentLinkedList<int>> snapshots;
+    for (int i = 0; i < 100000; i++)
+    {
+        list.pushFront(i);
+        if (i % 10000 == 0)
+            snapshots.push_back(list);
+    }
+    EXPECT_EQ(snapshots[3].size(), 30001);
+    EXPECT_EQ(snapshots[3].front(), 30000);
+    list.clear();
+    EXPECT_EQ(snapshots.back().size(), 90001);
+}
+
+TEST(C4_smart_ptrs_LinkedList, PersistentSnapshotGoesToAnotherThread)
+{
+    MemoryLeakDetector d;
+    PersistentLinkedList<int> list {1,2,3,4,5};
+    PersistentLinkedList<int> snapshot = list;
+
+    // both threads change their list and drop nodes the other one still shares
+    std::thread reader([snapshot = std::move(snapshot)]() mutable
+    {
+        for (int i = 0; i < 1000; i++)
+        {
+            snapshot.pushFront(i);
+            snapshot.insertAfter(++snapshot.begin(), i);
+            snapshot.popFront();
+        }
+        std::vector<int> values;
+        for (int value : snapshot)
+            values.push_back(value);
+        ASSERT_EQ(values.size(), 1005);
+        EXPECT_EQ(std::vector<int>(values.end() - 4, values.end()), (std::vector<int> {2,3,4,5}));
+    });
+    for (int i = 0; i < 1000; i++)
+    {
+        list.insertAfter(++(++list.begin()), i);
+        list.popFront();
+        list.pushFront(i);
+    }
+    list.clear();
+    reader.join();
+}
+
+TEST(C4_smart_ptrs_UnrolledList, SameInterfaceAsSmartPtrLinkedList)
+{
+    MemoryLeakDetector d;
+    UnrolledLinkedList<int> list {1,2,3};
+    list.pushFront(0);
+    auto it = list.insertAfter(list.begin(), 5);
+    EXPECT_EQ(*it, 5);
+    UnrolledLinkedList<int> expected {0,5,1,2,3};
+    EXPECT_EQ(list, expected);
+    EXPECT_EQ(*list.eraseAfter(it), 2);
+    list.popFront();
+    UnrolledLinkedList<int> afterErase {5,2,3};
+    EXPECT_EQ(list, afterErase);
+    EXPECT_EQ(list.size(), 3);
+    EXPECT_EQ(list.front(), 5);
+}
+
+TEST(C4_smart_ptrs_UnrolledList, SplitsAndMergesNodesLikeAList)
+{
+    MemoryLeakDetector d;
+    UnrolledLinkedList<std::string, 8> list;
+    std::list<std::string> reference;
+    list.pushFront("x");
+    reference.push_front("x");
+
+    uint32_t seed = 7;
+    auto next = [&seed] { seed = seed * 1664525 + 1013904223; return seed >> 8; };
+    for (int step = 0; step < 2000; step++)
+    {
+        size_t pos = next() % reference.size();
+        auto it = list.begin();
+        auto refIt = reference.begin();
+        for (size_t i = 0; i < pos; i++, ++it, ++refIt) {}
+
+        // grows for the first half, then mostly erases, so nodes get merged
+        bool erase = step < 1000 ? next() % 3 == 0 : next() % 4 != 0;
+        if (!erase || std::next(refIt) == reference.end())
+        {
+            std::string value = std::to_string(step);
+            EXPECT_EQ(*list.insertAfter(it, value), value);
+            reference.insert(std::next(refIt), value);
+        }
+        else
+        {
+            auto after = list.eraseAfter(it);
+            auto refAfter = reference.erase(std::next(refIt));
+            EXPECT_EQ(static_cast<bool>(after), refAfter != reference.end());
+            if (after) { EXPECT_EQ(*after, *refAfter); }
+        }
+        ASSERT_EQ(list.size(), reference.size());
+    }
+    EXPECT_TRUE(std::equal(reference.begin(), reference.end(), list.begin()));
+
+    UnrolledLinkedList<std::string, 8> copy = list;
+    EXPECT_EQ(copy, list);
+    while (!list.empty())
+    {
+        EXPECT_EQ(list.front(), reference.front());
+        list.popFront();
+        reference.pop_front();
+    }
+    EXPECT_NE(copy, list);
+}
+
+TEST(C4_smart_ptrs_UnrolledList, VeryBigListCorrectlyDeletes)
+{
+    MemoryLeakDetector d;
+    UnrolledLinkedList<int> list;
+    for (int i = 0; i < 1000000; i++) {
+        list.pushFront(i);
+    }
+    UnrolledLinkedList<int> moved = std::move(list);
+    EXPECT_TRUE(list.empty());
+    EXPECT_EQ(moved.size(), 1000000);
+    EXPECT_EQ(moved.front(), 999999);
+}
+
 TEST(C4_smart_ptrs_Pipml, PimplDoesNotLeaksMemory)
 {
     MemoryLeakDetector d;
@@ -120,4 +514,97 @@ TEST(C4_smart_ptrs_Pipml, PimplDoesNotLeaksMemory)
     numbers.remove(numberToRemove);
     EXPECT_EQ(numbers.size(), 4);
     EXPECT_EQ(copy.size(), 7);
-}
\ No newline at end of file
+}
+TEST(C4_smart_ptrs_Pipml, FastPimplKeepsTheImplementationInline)
+{
+    MemoryLeakDetector d;
+    static_assert(sizeof(MyCollection) <= 16 * sizeof(void*));
+    MyCollection numbers = {1, 2, 3};
+    MyCollection moved = std::move(numbers);
+    EXPECT_EQ(moved.size(), 3);
+    numbers.add(4); // a moved-from collection is still usable
+    EXPECT_EQ(numbers.size(), 1);
+    numbers = std::move(moved);
+    EXPECT_EQ(numbers.size(), 3);
+    const MyCollection& self = numbers;
+    numbers = self;
+    EXPECT_EQ(numbers.size(), 3);
+}
+
+TEST(C4_smart_ptrs_Pipml, IndexedModeMatchesUnordered)
+{
+    MemoryLeakDetector d;
+    MyCollection unordered;
+    MyCollection indexed {MyCollection::Mode::Indexed};
+    EXPECT_EQ(indexed.mode(), MyCollection::Mode::Indexed);
+    std::mt19937 rng {7};
+    for (int step = 0; step < 20000; step++)
+    {
+        int value = static_cast<int>(rng() % 500) - 250;
+        if (rng() % 3)
+        {
+            unordered.add(value);
+            indexed.add(value);
+        }
+        else
+        {
+            unordered.remove(value);
+            indexed.remove(value);
+        }
+        ASSERT_EQ(indexed.size(), unordered.size());
+        ASSERT_EQ(indexed.count(value), unordered.count(value));
+    }
+    for (int value = -250; value < 250; value++)
+        EXPECT_EQ(indexed.count(value), unordered.count(value));
+
+    MyCollection copy = indexed;
+    copy.remove(0);
+    EXPECT_EQ(copy.count(0), 0);
+    EXPECT_EQ(indexed.count(0), unordered.count(0));
+}
+
+TEST(C4_smart_ptrs_Pipml, MovedFromIndexedCollectionIsEmpty)
+{
+    MemoryLeakDetector d;
+    MyCollection a({1, 2, 2}, MyCollection::Mode::Indexed);
+    MyCollection b = std::move(a);
+    EXPECT_EQ(b.size(), 3);
+    EXPECT_EQ(b.count(2), 2);
+    EXPECT_EQ(a.size(), 0);
+    EXPECT_EQ(a.count(1), 0);
+
+    a.add(5);
+    a.add(5);
+    a.remove(5);
+    EXPECT_EQ(a.size(), 0);
+
+    a.add(1);
+    b = std::move(a);
+    EXPECT_EQ(b.size(), 1);
+    EXPECT_EQ(b.count(1), 1);
+    EXPECT_EQ(a.size(), 0);
+}
+
+TEST(C4_smart_ptrs_Pipml, BatchAddAndRemove)
+{
+    MemoryLeakDetector d;
+    std::vector<int> values;
+    for (int i = 0; i < 100000; i++)
+        values.push_back(i % 1000);
+    std::vector<int> removed = {5, 999, 5, 42, 1000};
+
+    for (auto mode : { MyCollection::Mode::Unordered, MyCollection::Mode::Indexed })
+    {
+        MyCollection numbers {mode};
+        numbers.add(values);
+        EXPECT_EQ(numbers.size(), 100000);
+        EXPECT_EQ(numbers.count(5), 100);
+        numbers.remove(removed);
+        EXPECT_EQ(numbers.size(), 100000 - 3 * 100);
+        EXPECT_EQ(numbers.count(5), 0);
+        EXPECT_EQ(numbers.count(42), 0);
+        EXPECT_EQ(numbers.count(43), 100);
+        numbers.remove(values);
+        EXPECT_EQ(numbers.size(), 0);
+    }
+}
@@ -1,8 +1,19 @@
 #include "7_the_concurrency_api.h"
+#include "ConcurrentQueue.h"
+#include "AdaptiveAsync.h"
+#include "LockFreeLinkedList.h"
+#include "AllocationTracker.h"
 #include "gtest/gtest.h"
 
 #include <system_error>
 #include <future>
+#include <stdexcept>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <optional>
 
 TEST(C7_concurrency, VolatileIsNotThreadSafe)
 {
@@ -70,4 +81,457 @@ TEST(C7_concurrency, AsyncLaunchIsAlwaysLaunchedInOtherThread)
 {
     auto pair = asyncMeasureTime(std::launch::async);
     EXPECT_GE(pair.first, pair.second);
-}
\ No newline at end of file
+}
+
+TEST(C7_concurrency, AtomicIsThreadSafeWithPool)
+{
+    ThreadPool pool {4};
+    const int nTasks = 1000;
+    for (int run = 0; run < 10; run++) // the same threads serve every run
+        EXPECT_EQ(multithreadAtomicIncrementWithPool(pool, nTasks), nTasks);
+}
+
+TEST(C7_concurrency, PoolSubmitReturnsResultOrException)
+{
+    ThreadPool pool {2};
+    auto value = pool.submit([] { return 42; });
+    auto error = pool.submit([]() -> int { throw std::runtime_error("task failed"); });
+    EXPECT_EQ(value.get(), 42);
+    EXPECT_THROW(error.get(), std::runtime_error);
+}
+
+TEST(C7_concurrency, PoolFreesJobsBeforePublishingTheirResult)
+{
+    ThreadPool pool {1};
+    for (int i = 0; i < 100; i++)
+    {
+        AllocationTracker tracker;
+        auto value = pool.submit([captured = std::vector<int>(64, i)] { return captured[0]; });
+        auto done = pool.bulk_submit(4, [captured = std::vector<int>(64, i)](size_t) {});
+        EXPECT_EQ(value.get(), i);
+        done.get();
+        // the jobs and their captured vectors are gone, only the futures' shared states may be left
+        EXPECT_GE(tracker.stats().deallocations, 5u); // job, vector; bulk state, helpers, vector
+    }
+}
+
+TEST(C7_concurrency, PoolBulkSubmitRunsEveryIndexOnce)
+{
+    ThreadPool pool {4};
+    for (size_t n : { 0, 1, 3, 1000, 100'000 })
+    {
+        std::vector<std::atomic<int>> calls(n);
+        pool.bulk_submit(n, [&calls](size_t i) { calls[i]++; }).get();
+        EXPECT_TRUE(std::all_of(calls.begin(), calls.end(), [](auto& c) { return c == 1; })) << n;
+    }
+
+    auto failed = pool.bulk_submit(100, [](size_t i) {
+        if (i == 50) throw std::runtime_error("index 50 failed");
+    });
+    EXPECT_THROW(failed.get(), std::runtime_error);
+}
+
+TEST(C7_concurrency, PoolRunsJobsBeyondQueueCapacity)
+{
+    ThreadPool pool {1};
+    std::promise<void> release;
+    auto blocker = pool.submit([f = release.get_future().share()] { f.wait(); });
+
+    // the only worker is blocked, so most of these end up in the overflow list
+    const int n = 10'000;
+    std::atomic<int> ran {0};
+    std::vector<std::future<void>> futures;
+    for (int i = 0; i < n; i++)
+        futures.push_back(pool.submit([&ran] { ran++; }));
+
+    release.set_value();
+    for (auto& f : futures)
+        f.get();
+    blocker.get();
+    EXPECT_EQ(ran, n);
+}
+
+TEST(C7_concurrency, ParseCpuListExpandsRanges)
+{
+    EXPECT_EQ(parseCpuList("0-3,8,10-11\n"), (std::vector<unsigned>{ 0, 1, 2, 3, 8, 10, 11 }));
+    EXPECT_EQ(parseCpuList("5"), (std::vector<unsigned>{ 5 }));
+    EXPECT_TRUE(parseCpuList("").empty());
+
+    auto nodes = numaNodes();
+    ASSERT_FALSE(nodes.empty());
+    EXPECT_FALSE(nodes.front().cpus.empty());
+}
+
+TEST(C7_concurrency, PoolPlacesWorkersAndGivesThemBuffers)
+{
+    for (auto placement : { WorkerPlacement::Unpinned, WorkerPlacement::Core, WorkerPlacement::Node })
+    {
+        ThreadPool pool {{ .threadCount = 4, .placement = placement, .workerBufferSize = 4096 }};
+        EXPECT_EQ(pool.placement(), placement);
+        EXPECT_GE(pool.nodeCount(), 1u);
+        if (placement == WorkerPlacement::Unpinned) EXPECT_EQ(pool.pinnedCount(), 0u);
+        else                                        EXPECT_LE(pool.pinnedCount(), 4u);
+
+        std::atomic<int> withBuffer {0};
+        pool.bulk_submit(100, [&](size_t) {
+            withBuffer += ThreadPool::workerBuffer().size() == 4096;
+        }).get();
+        EXPECT_EQ(withBuffer, 100) << toString(placement);
+    }
+    EXPECT_TRUE(ThreadPool::workerBuffer().empty());
+}
+
+TEST(C7_concurrency, AdaptiveAsyncRunsTinyTasksInline)
+{
+    ThreadPool pool {2};
+    auto tiny = [] { return std::this_thread::get_id(); };
+    auto& site = adaptiveCallSite<decltype(tiny)>();
+    EXPECT_FALSE(site.recent());
+
+    adaptive_async(pool, tiny).get();
+    EXPECT_NE(site.lastLaunch(), AdaptiveLaunch::Inline) << "run time is unknown yet";
+    ASSERT_TRUE(site.recent());
+
+    auto f = adaptive_async(pool, tiny);
+    EXPECT_EQ(site.lastLaunch(), AdaptiveLaunch::Inline);
+    EXPECT_EQ(f.wait_for(std::chrono::seconds(0)), std::future_status::ready);
+    EXPECT_EQ(f.get(), std::this_thread::get_id());
+
+    auto failing = [] { throw std::runtime_error("tiny failure"); };
+    for (int i = 0; i < 3; i++) // whichever launch it gets
+        EXPECT_THROW(adaptive_async(pool, failing).get(), std::runtime_error);
+}
+
+TEST(C7_concurrency, AdaptiveAsyncQueuesSlowTasksUnlessThePoolIsBusy)
+{
+    ThreadPool pool {1};
+    auto slow = [] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return std::this_thread::get_id();
+    };
+    auto& site = adaptiveCallSite<decltype(slow)>();
+    auto waitUntilIdle = [&pool] { while (pool.idleCount() == 0) std::this_thread::yield(); };
+
+    adaptive_async(pool, slow).get();
+    waitUntilIdle();
+    EXPECT_NE(adaptive_async(pool, slow).get(), std::this_thread::get_id());
+    EXPECT_EQ(site.lastLaunch(), AdaptiveLaunch::Pool);
+    EXPECT_GE(*site.recent(), std::chrono::milliseconds(1));
+
+    // the only worker is busy: the caller runs the task itself when it asks for the result
+    waitUntilIdle();
+    std::promise<void> release;
+    auto blocker = pool.submit([f = release.get_future().share()] { f.wait(); });
+    while (pool.idleCount() != 0) std::this_thread::yield();
+    auto deferred = adaptive_async(pool, slow);
+    EXPECT_EQ(site.lastLaunch(), AdaptiveLaunch::Deferred);
+    EXPECT_EQ(deferred.wait_for(std::chrono::seconds(0)), std::future_status::deferred);
+    EXPECT_EQ(deferred.get(), std::this_thread::get_id());
+    release.set_value();
+    blocker.get();
+
+    // a worker waiting for a job queued behind it would deadlock the pool
+    auto nested = pool.submit([&pool, &slow] { return adaptive_async(pool, slow).get(); });
+    EXPECT_NE(nested.get(), std::this_thread::get_id());
+    EXPECT_EQ(site.lastLaunch(), AdaptiveLaunch::Deferred);
+}
+
+TEST(C7_concurrency, StartGateReleasesEveryParticipantAfterOpen)
+{
+    const int nThreads = 8;
+    StartGate gate {nThreads, 64}; // short spin, so some of them sleep
+    std::atomic<int> started {0};
+    std::atomic<bool> startedEarly {false};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < nThreads; i++)
+        threads.emplace_back([&] {
+            gate.arriveAndWait();
+            started++;
+        });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    startedEarly = started > 0;
+    gate.open();
+    for (auto& t : threads)
+        t.join();
+
+    EXPECT_FALSE(startedEarly);
+    EXPECT_EQ(started, nThreads);
+    EXPECT_GE(gate.skew(), StartGate::clock::duration::zero());
+    EXPECT_GE(gate.wakeLatency(), gate.skew());
+}
+
+TEST(C7_concurrency, ShardedCounterIsThreadSafe)
+{
+    const int nThreads = 1000;
+    try
+    {
+        EXPECT_EQ(multithreadShardedIncrement(nThreads), nThreads);
+    }
+    catch(const std::system_error& err)
+    {
+        FAIL() << "Error while creating threads:\n" << err.what();
+    }
+
+    ShardedCounter<int> counter {3};
+    EXPECT_EQ(counter.shardCount(), 4u);
+    counter.add(5);
+    counter.add(-2);
+    EXPECT_EQ(counter.read(), 3);
+}
+
+TEST(C7_concurrency, LatencyHistogramBucketsStayWithinRelativeError)
+{
+    for (uint64_t ns : { 0ull, 1ull, 31ull, 32ull, 33ull, 1'000ull, 123'456'789ull, 1ull << 62 })
+    {
+        uint64_t high = detail::latencyBucketHigh(detail::latencyBucket(ns));
+        EXPECT_GE(high, ns);
+        EXPECT_LE(high - ns, ns / 32) << ns;
+    }
+    EXPECT_LT(detail::latencyBucket(~0ull), detail::LATENCY_BUCKETS);
+}
+
+TEST(C7_concurrency, LatencyHistogramReportsPercentiles)
+{
+    using namespace std::chrono_literals;
+    LatencyHistogram h;
+    for (int i = 1; i <= 1000; i++)
+        h.record(std::chrono::microseconds(i));
+
+    auto s = h.summary();
+    EXPECT_EQ(s.count, 1000u);
+    EXPECT_EQ(s.max, 1000us);
+    EXPECT_NEAR(s.p50.count(), 500'000, 500'000 / 32);
+    EXPECT_NEAR(s.p99.count(), 990'000, 990'000 / 32);
+    EXPECT_NEAR(s.p999.count(), 999'000, 999'000 / 32);
+    EXPECT_EQ(h.mean(), 500500ns);
+}
+
+TEST(C7_concurrency, LatencyRecorderMergesEveryThread)
+{
+    const int nThreads = 8;
+    const int perThread = 10'000;
+    LatencyRecorder recorder;
+    useThreads(nThreads, std::promise<void>{}, [&recorder] {
+        for (int i = 0; i < perThread; i++)
+            recorder.record(std::chrono::nanoseconds(i));
+    });
+    { auto timer = recorder.time(); }
+
+    auto merged = recorder.snapshot();
+    EXPECT_EQ(merged.count(), uint64_t{nThreads} * perThread + 1);
+    EXPECT_GE(merged.max(), std::chrono::nanoseconds(perThread - 1));
+}
+
+TEST(C7_concurrency, LatencyRecorderSharesShardsBetweenThreads)
+{
+    const int nThreads = 8;
+    const int perThread = 10'000;
+    LatencyRecorder recorder {2};
+    EXPECT_EQ(recorder.shardCount(), 2u);
+    useThreads(nThreads, std::promise<void>{}, [&recorder] {
+        for (int i = 0; i < perThread; i++)
+            recorder.record(std::chrono::nanoseconds(i));
+    });
+    const std::chrono::nanoseconds longest {perThread};
+    for (int i = 0; i < nThreads; i++) // threads that come and go reuse the shards
+        std::thread { [&recorder, &longest] { recorder.record(longest); } }.join();
+
+    auto merged = recorder.snapshot();
+    EXPECT_EQ(merged.count(), uint64_t{nThreads} * (perThread + 1));
+    EXPECT_EQ(merged.max(), longest);
+}
+
+TEST(C7_concurrency, MpmcQueueIsBoundedFifo)
+{
+    MpmcQueue<int> queue {3};
+    EXPECT_EQ(queue.capacity(), 4u);
+    EXPECT_FALSE(queue.tryPop());
+    for (int i = 0; i < 4; i++)
+        EXPECT_TRUE(queue.tryPush(int{i}));
+    EXPECT_FALSE(queue.tryPush(4));
+
+    for (int i = 0; i < 4; i++)
+        EXPECT_EQ(queue.tryPop(), i);
+    EXPECT_FALSE(queue.tryPop());
+    EXPECT_TRUE(queue.tryPush(5)); // wraps around
+    EXPECT_EQ(queue.tryPop(), 5);
+}
+
+TEST(C7_concurrency, SpscQueueKeepsOrderBetweenThreads)
+{
+    const int n = 100'000;
+    BlockingQueue<SpscQueue<int>> queue {64};
+    std::thread producer([&] {
+        for (int i = 0; i < n; i++)
+            queue.push(int{i});
+        queue.close();
+    });
+
+    int expected = 0;
+    bool ordered = true;
+    while (auto value = queue.pop())
+        ordered = ordered && *value == expected++;
+    producer.join();
+
+    EXPECT_TRUE(ordered);
+    EXPECT_EQ(expected, n);
+}
+
+TEST(C7_concurrency, BlockingMpmcQueueDeliversEveryValueOnce)
+{
+    const int nProducers = 4, nConsumers = 4, perProducer = 25'000;
+    BlockingQueue<MpmcQueue<int>> queue {16}; // small, so both sides block
+    std::vector<std::atomic<int>> seen(nProducers * perProducer);
+
+    std::vector<std::thread> consumers;
+    for (int c = 0; c < nConsumers; c++)
+        consumers.emplace_back([&] {
+            while (auto value = queue.pop())
+                seen[*value]++;
+        });
+    std::vector<std::thread> producers;
+    for (int p = 0; p < nProducers; p++)
+        producers.emplace_back([&, p] {
+            for (int i = 0; i < perProducer; i++)
+                EXPECT_TRUE(queue.push(p * perProducer + i));
+        });
+
+    for (auto& t : producers)
+        t.join();
+    queue.close();
+    for (auto& t : consumers)
+        t.join();
+
+    EXPECT_TRUE(std::all_of(seen.begin(), seen.end(), [](auto& c) { return c == 1; }));
+    EXPECT_FALSE(queue.push(0));
+}
+
+TEST(C7_concurrency, BlockingQueueCloseWakesWaitingConsumers)
+{
+    BlockingQueue<MpmcQueue<int>> queue {4};
+    std::vector<std::future<std::optional<int>>> consumers;
+    for (int i = 0; i < 3; i++)
+        consumers.push_back(std::async(std::launch::async, [&queue] { return queue.pop(); }));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    queue.close();
+    for (auto& c : consumers)
+        EXPECT_FALSE(c.get());
+    EXPECT_TRUE(queue.isClosed());
+}
+
+TEST(C7_concurrency, EventCountNotifyOneWakesASingleSleeper)
+{
+    EventCount event;
+    std::atomic<int> woken {0};
+    std::vector<std::thread> sleepers;
+    for (int i = 0; i < 3; i++)
+        sleepers.emplace_back([&] {
+            uint32_t key = event.prepareWait();
+            event.wait(key);
+            woken++;
+        });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50)); // let them fall asleep
+    event.notifyOne();
+    while (woken == 0)
+        std::this_thread::yield();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(woken, 1);
+
+    event.notify();
+    for (auto& t : sleepers)
+        t.join();
+    EXPECT_EQ(woken, 3);
+}
+
+TEST(C7_concurrency, LockFreeListIsAnOrderedSet)
+{
+    LockFreeLinkedList<int> list;
+    EXPECT_TRUE(list.empty());
+    for (int value : { 5, 1, 3, 4, 2 })
+        EXPECT_TRUE(list.insert(value));
+    EXPECT_FALSE(list.insert(3));
+    EXPECT_TRUE(list.contains(4));
+    EXPECT_TRUE(list.erase(4));
+    EXPECT_FALSE(list.erase(4));
+    EXPECT_FALSE(list.contains(4));
+
+    std::vector<int> values;
+    list.forEach([&values](int v) { values.push_back(v); });
+    EXPECT_EQ(values, (std::vector<int> {1, 2, 3, 5}));
+    EXPECT_EQ(list.size(), 4u);
+}
+
+namespace
+{
+    struct Tracked
+    {
+        static inline std::atomic<int> alive {0};
+        int value;
+
+        Tracked(int value) : value {value} { alive++; }
+        Tracked(const Tracked& other) : value {other.value} { alive++; }
+        ~Tracked() { alive--; }
+        bool operator<(const Tracked& other) const noexcept { return value < other.value; }
+    };
+}
+
+TEST(C7_concurrency, LockFreeListStressWithReclamation)
+{
+    const int nWriters = 4, nReaders = 2, keys = 256, rounds = 20'000;
+    {
+        LockFreeLinkedList<Tracked> list;
+        std::atomic<bool> done {false};
+        std::atomic<bool> ordered {true};
+        std::vector<std::atomic<int>> balance(keys); // inserts minus erases per key
+
+        std::vector<std::thread> readers;
+        for (int r = 0; r < nReaders; r++)
+            readers.emplace_back([&] {
+                while (!done)
+                {
+                    int last = -1;
+                    list.forEach([&](const Tracked& t) {
+                        if (t.value <= last) ordered = false;
+                        last = t.value;
+                    });
+                    list.contains(Tracked {keys / 2});
+                }
+            });
+        std::vector<std::thread> writers;
+        for (int w = 0; w < nWriters; w++)
+            writers.emplace_back([&, w] {
+                uint32_t x = 12345 + w;
+                for (int i = 0; i < rounds; i++)
+                {
+                    x = x * 1664525 + 1013904223;
+                    int key = (x >> 8) % keys;
+                    if (x & 0x80)
+                        balance[key] += list.insert(Tracked {key});
+                    else
+                        balance[key] -= list.erase(Tracked {key});
+                }
+            });
+        for (auto& t : writers)
+            t.join();
+        done = true;
+        for (auto& t : readers)
+            t.join();
+
+        EXPECT_TRUE(ordered);
+        std::vector<int> expected, actual;
+        for (int key = 0; key < keys; key++)
+        {
+            ASSERT_TRUE(balance[key] == 0 || balance[key] == 1);
+            if (balance[key]) expected.push_back(key);
+        }
+        list.forEach([&actual](const Tracked& t) { actual.push_back(t.value); });
+        EXPECT_EQ(actual, expected);
+    }
+    // the writer threads are gone, their retired nodes are adopted here
+    EpochReclaimer::collect();
+    EpochReclaimer::collect();
+    EXPECT_EQ(Tracked::alive, 0);
+}
@@ -1,7 +1,22 @@
 #include "9_coroutines.h"
+#include "Channel.h"
+#include "FtpExampleAsync.h"
+#include "FtpExampleCoro.h"
+#include "FtpExampleSync.h"
+#include "FtpExampleSim.h"
+#include "FtpLatency.h"
+#include "VirtualTimeScheduler.h"
+#include "RunLoop.h"
 #include "gtest/gtest.h"
 #include "MemoryLeakDetector.h"
 #include <sstream>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <optional>
 
 TEST(Coroutines, InititalSuspendNeverStartsCoroutine)
 {
@@ -119,6 +134,34 @@ TEST(Coroutines, GeneratorStepsCorrectly)
     }
 }
 
+TEST(Coroutines, AllocationTrackerScopes)
+{
+    AllocationTracker process {AllocationTracker::Scope::Process};
+    AllocationTracker thread;
+    int* leaked = nullptr;
+    std::thread { [&leaked] { leaked = new int {42}; } }.join();
+    EXPECT_GE(process.stats().liveBytes, static_cast<ptrdiff_t>(sizeof(int))); // a process-wide MemoryLeakDetector would fail here
+    EXPECT_LE(thread.stats().liveBytes, 0); // the other thread's block is not ours
+    delete leaked;
+    EXPECT_LE(process.stats().liveBytes, 0);
+
+    // freed by another thread, still counted for the one that allocated it
+    int* handedOver = new int {42};
+    EXPECT_GE(thread.stats().liveBytes, static_cast<ptrdiff_t>(sizeof(int)));
+    std::thread { [handedOver] { delete handedOver; } }.join();
+    EXPECT_LE(thread.stats().liveBytes, 0);
+}
+
+TEST(Coroutines, GeneratorIterationDoesNotAllocate)
+{
+    MemoryLeakDetector d;
+    auto gen = range<int>(1, 10'000);
+    ASSERT_TRUE(gen.next()); // the frame was allocated by the call
+    EXPECT_TRUE(allocatesAtMost(0, [&] {
+        while (gen.next()) {}
+    }));
+}
+
 TEST(Coroutines, TaskDoesntStartUntilAwaited)
 {
     MemoryLeakDetector d;
@@ -149,6 +192,26 @@ TEST(Coroutines, TaskDoesNotStackOverflow)
     });
 }
 
+TEST(Coroutines, TaskResumptionOnlyAllocatesFrames)
+{
+    MemoryLeakDetector d;
+    auto child = [](int x) -> Task<int> {
+        co_return x;
+    };
+    auto parent = [&child](int count) -> Task<int> {
+        int sum = 0;
+        for (int i = 0; i < count; i++)
+            sum += co_await child(i);
+        co_return sum;
+    };
+    const int count = 1000;
+    // a frame per child, the parent's and startTask's
+    EXPECT_TRUE(allocatesAtMost(count + 2, [&] {
+        auto handle = startTask(parent(count));
+        EXPECT_EQ(handle.result(), count * (count - 1) / 2);
+    }));
+}
+
 TEST(Coroutines, TaskReturnsCorrectly)
 {
     MemoryLeakDetector d;
@@ -187,3 +250,558 @@ TEST(Coroutines, NonVoidTaskThrowsOnObtainingResult)
     auto task = startTask(throwsTask());
     ASSERT_THROW(task.result(), my_exception);
 }
+
+TEST(Coroutines, ChannelPassesValuesInOrder)
+{
+    MemoryLeakDetector d;
+    const int count = 10'000;
+    Channel<int> channel {8};
+
+    auto producer = [&]() -> Task<> {
+        for (int i = 0; i < count; i++)
+            co_await channel.send(i);
+        channel.close();
+    };
+    auto consumer = [&]() -> Task<std::vector<int>> {
+        std::vector<int> received;
+        while (auto value = co_await channel.receive())
+            received.push_back(*value);
+        co_return received;
+    };
+
+    std::thread t { [&] { syncWait(producer()); } };
+    auto received = syncWait(consumer());
+    t.join();
+
+    ASSERT_EQ(received.size(), count);
+    for (int i = 0; i < count; i++)
+        ASSERT_EQ(received[i], i);
+}
+
+TEST(Coroutines, ChannelSendSuspendsWhileFull)
+{
+    MemoryLeakDetector d;
+    Channel<int> channel {2};
+    int sent = 0;
+
+    auto producer = [&]() -> Task<> {
+        for (int i = 0; i < 3; i++)
+        {
+            co_await channel.send(i);
+            sent++;
+        }
+    };
+    auto receiveOne = [&]() -> Task<int> {
+        co_return *co_await channel.receive();
+    };
+
+    auto p = producer();
+    auto started = startTask(std::move(p));
+    EXPECT_EQ(sent, 2);
+    EXPECT_FALSE(p.ready());
+
+    EXPECT_EQ(startTask(receiveOne()).result(), 0);
+    EXPECT_EQ(sent, 3);
+    EXPECT_TRUE(p.ready());
+}
+
+TEST(Coroutines, ChannelCloseWakesParkedReceivers)
+{
+    MemoryLeakDetector d;
+    Channel<int> channel {4};
+    bool gotNothing = false;
+
+    auto consumer = [&]() -> Task<> {
+        gotNothing = !co_await channel.receive();
+    };
+
+    auto c = consumer();
+    auto started = startTask(std::move(c));
+    EXPECT_FALSE(c.ready());
+
+    channel.close();
+    EXPECT_TRUE(c.ready());
+    EXPECT_TRUE(gotNothing);
+
+    auto sendAfterClose = [&]() -> Task<bool> {
+        co_return co_await channel.send(1);
+    };
+    EXPECT_FALSE(startTask(sendAfterClose()).result());
+}
+
+TEST(Coroutines, ChannelDeliversEveryValueOnceToManyConsumers)
+{
+    MemoryLeakDetector d;
+    const int nProducers = 4;
+    const int nConsumers = 4;
+    const int perProducer = 10'000;
+    Channel<int> channel {16};
+    std::atomic<int> producersLeft {nProducers};
+
+    auto producer = [&](int id) -> Task<> {
+        for (int i = 0; i < perProducer; i++)
+            co_await channel.send(id * perProducer + i);
+        if (--producersLeft == 0) channel.close();
+    };
+    auto consumer = [&]() -> Task<std::vector<int>> {
+        std::vector<int> received;
+        while (auto value = co_await channel.receive())
+            received.push_back(*value);
+        co_return received;
+    };
+
+    std::vector<std::thread> threads;
+    std::vector<std::vector<int>> received(nConsumers);
+    for (int i = 0; i < nProducers; i++)
+        threads.emplace_back([&, i] { syncWait(producer(i)); });
+    for (int i = 0; i < nConsumers; i++)
+        threads.emplace_back([&, i] { received[i] = syncWait(consumer()); });
+    for (auto& t : threads)
+        t.join();
+
+    std::vector<int> all;
+    for (auto& r : received)
+        all.insert(all.end(), r.begin(), r.end());
+    std::sort(all.begin(), all.end());
+    ASSERT_EQ(all.size(), nProducers * perProducer);
+    for (int i = 0; i < nProducers * perProducer; i++)
+        ASSERT_EQ(all[i], i);
+}
+
+TEST(Coroutines, FtpPipelineDownloadsAllMatches)
+{
+    MemoryLeakDetector d;
+    const std::string path = getProjectPath() + "/src/include";
+    size_t expected = 0;
+    for (const auto& e : std::filesystem::directory_iterator{path})
+        if (e.path().string().ends_with(".h")) expected++;
+
+    kw::FTPExampleCoro ftp;
+    auto files = ftp.downloadAllMatches({ path, path },
+        [](std::string_view f) { return f.ends_with(".h"); },
+        [](int) {}, 2).get();
+
+    EXPECT_EQ(files.size(), 2 * expected);
+}
+
+TEST(Coroutines, FtpPipelineReportsListErrors)
+{
+    MemoryLeakDetector d;
+    kw::FTPExampleCoro ftp;
+    auto files = ftp.downloadAllMatches({ getProjectPath() + "/does/not/exist" },
+        [](std::string_view) { return true; },
+        [](int) {});
+    EXPECT_THROW(files.get(), std::runtime_error);
+}
+
+TEST(Coroutines, ExpectedTaskPropagatesErrorWithoutThrowing)
+{
+    MemoryLeakDetector d;
+    auto inner = [](bool fail) -> Task<Expected<int, kw::FtpError>> {
+        if (fail) co_return Unexpected{kw::FtpError::NoMatch};
+        co_return 21;
+    };
+    auto outer = [&inner](bool fail) -> Task<Expected<int, kw::FtpError>> {
+        auto value = co_await inner(fail);
+        if (!value) co_return Unexpected{value.error()};
+        co_return *value * 2;
+    };
+
+    auto ok = startTask(outer(false)).result();
+    ASSERT_TRUE(ok.has_value());
+    EXPECT_EQ(*ok, 42);
+
+    auto failed = startTask(outer(true)).result();
+    ASSERT_FALSE(failed.has_value());
+    EXPECT_EQ(failed.error(), kw::FtpError::NoMatch);
+}
+
+TEST(Coroutines, FtpTryDownloadReturnsErrors)
+{
+    MemoryLeakDetector d;
+    const std::string path = getProjectPath() + "/src/include";
+    kw::FTPExampleCoro ftp;
+
+    auto noMatch = syncWait(ftp.tryDownloadFirstMatch(path,
+        [](std::string_view) { return false; }, [](int) {}));
+    ASSERT_FALSE(noMatch.has_value());
+    EXPECT_EQ(noMatch.error(), kw::FtpError::NoMatch);
+
+    auto noPath = syncWait(ftp.tryDownloadFirstMatch(path + "/does/not/exist",
+        [](std::string_view) { return true; }, [](int) {}));
+    ASSERT_FALSE(noPath.has_value());
+    EXPECT_EQ(noPath.error(), kw::FtpError::PathNotFound);
+
+    auto found = syncWait(ftp.tryDownloadFirstMatch(path,
+        [](std::string_view f) { return f.ends_with("Task.h"); }, [](int) {}));
+    ASSERT_TRUE(found.has_value());
+    EXPECT_TRUE(std::filesystem::exists(*found));
+}
+
+TEST(Coroutines, FtpDownloadsCopyTheWholeFile)
+{
+    ThreadPool pool {1};
+    MemoryLeakDetector d {AllocationTracker::Scope::Process}; // the downloads run on other threads
+    const std::string path = getProjectPath() + "/src/include";
+    auto isTask = [](std::string_view f) { return f.ends_with("/Task.h"); };
+    const auto expected = std::filesystem::file_size(path + "/Task.h");
+
+    kw::FTPExampleSync sync;
+    kw::FTPExampleAsync async {pool};
+    kw::FTPExampleCoro coro;
+    for (const std::string& tempPath : { sync.downloadFirstMatch(path, isTask, [](int) {}),
+                                         async.downloadFirstMatch(path, isTask, [](int) {}).get(),
+                                         coro.downloadFirstMatch(path, isTask, [](int) {}).get() })
+        EXPECT_EQ(std::filesystem::file_size(tempPath), expected);
+}
+
+TEST(Coroutines, FtpCachedDownloadDoesNotAllocate)
+{
+    MemoryLeakDetector d;
+    const std::string path = getProjectPath() + "/src/include";
+    kw::FTPExampleSync ftp;
+    int progress = 0;
+    auto download = [&] {
+        return ftp.tryDownloadFirstMatchCached(path,
+            [](std::string_view f) { return f.ends_with("/Task.h"); },
+            [&progress](int p) { progress = p; });
+    };
+
+    auto first = download(); // LIST and the buffers
+    ASSERT_TRUE(first.has_value());
+    const std::string tempPath {*first};
+    EXPECT_TRUE(std::filesystem::exists(tempPath));
+    EXPECT_EQ(progress, 100);
+    EXPECT_EQ(std::filesystem::file_size(tempPath), std::filesystem::file_size(path + "/Task.h"));
+
+    EXPECT_TRUE(allocatesAtMost(0, [&] {
+        for (int i = 0; i < 10; i++)
+        {
+            auto again = download();
+            ASSERT_TRUE(again.has_value());
+            ASSERT_EQ(*again, tempPath);
+        }
+    }));
+}
+
+TEST(Coroutines, FtpCachedDownloadListsAChangedDirAgain)
+{
+    MemoryLeakDetector d;
+    const auto dir = std::filesystem::temp_directory_path() / "kw_ftp_cached_listing";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directory(dir);
+    std::ofstream {dir / "a.txt"} << "a";
+    // a listing within the same write time step is not cached at all
+    std::this_thread::sleep_for(kw::FTPExampleSync::TIMESTAMP_GRANULARITY);
+
+    kw::FTPExampleSync ftp;
+    auto download = [&](std::string_view extension) {
+        return ftp.tryDownloadFirstMatchCached(dir.string(),
+            [extension](std::string_view f) { return f.ends_with(extension); }, [](int) {});
+    };
+    EXPECT_TRUE(download(".txt").has_value());
+    auto missing = download(".log");
+    ASSERT_FALSE(missing.has_value());
+    EXPECT_EQ(missing.error(), kw::FtpError::NoMatch);
+
+    std::ofstream {dir / "b.log"} << "b";
+    EXPECT_TRUE(download(".log").has_value());
+    EXPECT_EQ(ftp.getListed().size(), 2);
+    // likely the same write time as b.log, but that listing was too recent to keep
+    std::ofstream {dir / "c.log"} << "c";
+    EXPECT_TRUE(download(".log").has_value());
+    EXPECT_EQ(ftp.getListed().size(), 3);
+
+    auto noPath = download(".txt");
+    std::filesystem::remove_all(dir);
+    EXPECT_EQ(download(".txt").error(), kw::FtpError::PathNotFound);
+    EXPECT_TRUE(noPath.has_value());
+}
+
+TEST(Coroutines, FtpThrowingApiKeepsErrorCode)
+{
+    MemoryLeakDetector d;
+    kw::FTPExampleSync ftp;
+    try
+    {
+        ftp.downloadFirstMatch(getProjectPath(),
+            [](std::string_view) { return false; }, [](int) {});
+        FAIL() << "downloadFirstMatch should throw when nothing matches";
+    }
+    catch (const std::system_error& e)
+    {
+        EXPECT_EQ(e.code(), kw::FtpError::NoMatch);
+        EXPECT_EQ(std::string_view{e.what()}.find(getProjectPath()), 0); // names the dir searched
+    }
+    try
+    {
+        kw::valueOrThrow(kw::FtpResult<int>{Unexpected{kw::FtpError::DownloadFailed}}, {});
+        FAIL() << "valueOrThrow should throw on an error";
+    }
+    catch (const std::system_error& e)
+    {
+        EXPECT_EQ(std::string{e.what()}, e.code().message()); // no ": " without a context
+    }
+    auto result = ftp.tryDownloadFirstMatch(getProjectPath(),
+        [](std::string_view) { return false; }, [](int) {});
+    ASSERT_FALSE(result.has_value());
+    EXPECT_EQ(result.error(), kw::FtpError::NoMatch);
+}
+
+TEST(Coroutines, VirtualTimeSchedulerFiresTimersInDeadlineOrder)
+{
+    MemoryLeakDetector d;
+    using namespace std::chrono_literals;
+    VirtualTimeScheduler scheduler;
+    std::vector<std::pair<int, long long>> wakeUps;
+
+    auto sleeper = [&](int id, std::chrono::milliseconds delay) -> Task<> {
+        co_await scheduler.sleepFor(delay);
+        wakeUps.emplace_back(id, scheduler.now().sinceStart.count());
+    };
+    scheduler.spawn(sleeper(1, 30ms));
+    scheduler.spawn(sleeper(2, 10ms));
+    scheduler.spawn(sleeper(3, 30ms));
+    scheduler.spawn(sleeper(4, 0ms));
+
+    auto start = std::chrono::steady_clock::now();
+    scheduler.run();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 10ms) << "virtual sleeps must not block";
+
+    std::vector<std::pair<int, long long>> expected {
+        {4, 0}, {2, 10'000'000}, {1, 30'000'000}, {3, 30'000'000}
+    };
+    EXPECT_EQ(wakeUps, expected);
+    EXPECT_TRUE(scheduler.done());
+}
+
+namespace
+{
+    struct SimulationResult
+    {
+        std::vector<long long> latenciesNs;
+        long long makespanNs = 0;
+    };
+
+    SimulationResult simulateConcurrentDownloads(int nDirs, int filesPerDir)
+    {
+        using namespace std::chrono_literals;
+        VirtualTimeScheduler scheduler;
+        kw::FTPExampleSim ftp { scheduler, {
+            .list = 5ms,
+            .firstByte = 20ms,
+            .bytesPerSecond = 1'000'000,
+            .extra = [](const kw::RemoteDirEntry& e) { // slow tail: every 10th file
+                return (e.size / 1000) % 10 == 0 ? 500ms : 0ms;
+            },
+        }};
+        for (int dir = 0; dir < nDirs; dir++)
+            for (int file = 0; file < filesPerDir; file++)
+                ftp.addRemoteFile("/dir" + std::to_string(dir), "file" + std::to_string(file), 1000 * (file + 1));
+
+        SimulationResult result;
+        for (int dir = 0; dir < nDirs; dir++)
+        {
+            for (int file = 0; file < filesPerDir; file++)
+            {
+                scheduler.spawn([](VirtualTimeScheduler& s, kw::FTPExampleSim& ftp, SimulationResult& result,
+                                   std::string dir, std::string name) -> Task<> {
+                    auto start = s.now();
+                    auto path = co_await ftp.tryDownloadFirstMatch(dir,
+                        [&name](std::string_view f) { return f.ends_with(name); }, [](int) {});
+                    if (!path) throw std::runtime_error{"simulated download failed"};
+                    result.latenciesNs.push_back((s.now() - start).count());
+                }(scheduler, ftp, result, "/dir" + std::to_string(dir), "/file" + std::to_string(file)));
+            }
+        }
+        scheduler.run();
+        result.makespanNs = scheduler.now().sinceStart.count();
+        return result;
+    }
+}
+
+TEST(Coroutines, VirtualTimeSimulationIsRepeatable)
+{
+    MemoryLeakDetector d;
+    const int nDirs = 100;
+    const int filesPerDir = 100;
+    auto first = simulateConcurrentDownloads(nDirs, filesPerDir);
+    auto second = simulateConcurrentDownloads(nDirs, filesPerDir);
+
+    ASSERT_EQ(first.latenciesNs.size(), nDirs * filesPerDir);
+    EXPECT_EQ(first.latenciesNs, second.latenciesNs);
+    EXPECT_EQ(first.makespanNs, second.makespanNs);
+
+    // the fastest download is the smallest file without injected latency:
+    // LIST 5ms + first byte 20ms + 1000 bytes at 1MB/s
+    const long long ms = 1'000'000;
+    auto sorted = first.latenciesNs;
+    std::sort(sorted.begin(), sorted.end());
+    EXPECT_EQ(sorted.front(), 26 * ms);
+    // the slowest is the biggest file (100KB, 100ms transfer) with the injected tail latency
+    EXPECT_EQ(sorted.back(), (5 + 20 + 100 + 500) * ms);
+    EXPECT_EQ(first.makespanNs, sorted.back());
+    EXPECT_GT(sorted[sorted.size() * 999 / 1000], sorted[sorted.size() / 2]);
+}
+
+TEST(Coroutines, RunLoopResumesTasksOnOwnerThread)
+{
+    MemoryLeakDetector d;
+    RunLoop loop;
+    std::thread::id resumedOn;
+
+    auto task = [&]() -> Task<> {
+        co_await loop.schedule();
+        resumedOn = std::this_thread::get_id();
+    };
+
+    auto t = task();
+    std::optional<SyncWaitTask<void>> started;
+    std::thread other { [&] { started.emplace(startTask(std::move(t))); } };
+    other.join();
+
+    EXPECT_FALSE(t.ready());
+    EXPECT_TRUE(loop.run_one());
+    EXPECT_TRUE(t.ready());
+    EXPECT_EQ(resumedOn, std::this_thread::get_id());
+}
+
+TEST(Coroutines, RunLoopRunsUntilIdleInScheduleOrder)
+{
+    MemoryLeakDetector d;
+    RunLoop loop;
+    std::vector<int> order;
+
+    auto task = [&](int id) -> Task<> {
+        co_await loop.schedule();
+        order.push_back(id);
+        co_await loop.schedule(); // rescheduled behind the others
+        order.push_back(id + 10);
+    };
+
+    auto t1 = task(1);
+    auto t2 = task(2);
+    auto s1 = startTask(std::move(t1));
+    auto s2 = startTask(std::move(t2));
+    EXPECT_TRUE(order.empty());
+
+    EXPECT_EQ(loop.run_until_idle(), 4);
+    EXPECT_EQ(order, (std::vector {1, 2, 11, 12}));
+    EXPECT_EQ(loop.run_until_idle(), 0);
+}
+
+TEST(Coroutines, RunLoopRunReturnsAfterStop)
+{
+    MemoryLeakDetector d;
+    RunLoop loop;
+    int resumed = 0;
+
+    auto task = [&]() -> Task<> {
+        co_await loop.schedule();
+        if (++resumed == 100) loop.stop();
+    };
+
+    std::vector<Task<>> tasks;
+    std::vector<SyncWaitTask<void>> started;
+    for (int i = 0; i < 100; i++)
+        tasks.push_back(task());
+    started.reserve(tasks.size());
+    std::thread producer { [&] {
+        for (auto& t : tasks) started.push_back(startTask(std::move(t)));
+    }};
+    loop.run();
+    producer.join();
+    EXPECT_EQ(resumed, 100);
+}
+
+TEST(Coroutines, ScheduleOnAndResumeOnHopBetweenExecutors)
+{
+    MemoryLeakDetector d;
+    RunLoop io, ui;
+    std::thread ioThread { [&] { io.run(); } };
+
+    auto work = [](bool fail) -> Task<std::thread::id> {
+        if (fail) throw std::runtime_error("io failure");
+        co_return std::this_thread::get_id();
+    };
+    std::thread::id ranOn, continuedOn, failedOn;
+    auto task = [&]() -> Task<> {
+        ranOn = co_await resume_on(ui, schedule_on(io, work(false)));
+        continuedOn = std::this_thread::get_id();
+        try { co_await resume_on(ui, schedule_on(io, work(true))); }
+        catch (const std::runtime_error&) { failedOn = std::this_thread::get_id(); }
+        ui.stop();
+    };
+
+    auto t = task();
+    auto started = startTask(std::move(t));
+    ui.run();
+    auto ioId = ioThread.get_id();
+    io.stop();
+    ioThread.join();
+
+    EXPECT_EQ(ranOn, ioId);
+    EXPECT_EQ(continuedOn, std::this_thread::get_id());
+    EXPECT_EQ(failedOn, std::this_thread::get_id());
+}
+
+TEST(Coroutines, FtpProgressIsDeliveredOnUiExecutor)
+{
+    MemoryLeakDetector d;
+    RunLoop io, ui;
+    std::thread ioThread { [&] { io.run(); } };
+
+    kw::FTPExampleCoro ftp;
+    std::vector<int> progress;
+    bool allOnUi = true;
+    std::optional<kw::FtpResult<std::string>> result;
+    auto task = [&]() -> Task<> {
+        result = co_await ftp.tryDownloadFirstMatch(io, ui, getProjectPath() + "/src/include",
+            [](std::string_view f) { return f.ends_with("Task.h"); },
+            [&](int p) {
+                allOnUi = allOnUi && RunLoop::current() == &ui;
+                progress.push_back(p);
+            });
+        ui.stop();
+    };
+
+    auto t = task();
+    auto started = startTask(std::move(t));
+    ui.run();
+    io.stop();
+    ioThread.join();
+
+    ASSERT_TRUE(result && result->has_value());
+    EXPECT_TRUE(std::filesystem::exists(**result));
+    EXPECT_TRUE(allOnUi);
+    ASSERT_FALSE(progress.empty());
+    EXPECT_TRUE(std::is_sorted(progress.begin(), progress.end()));
+}
+
+TEST(Coroutines, FtpStepsRecordLatencyPerCall)
+{
+    auto& latency = kw::ftpLatency();
+    auto download = [] {
+        kw::FTPExampleCoro ftp;
+        return syncWait(ftp.tryDownloadFirstMatch(getProjectPath() + "/src/include",
+            [](std::string_view f) { return f.ends_with("Task.h"); }, [](int) {}));
+    };
+    kw::enableFtpLatency();
+    ASSERT_TRUE(download().has_value()); // this thread's shards live as long as the recorders
+
+    MemoryLeakDetector d;
+    auto lists = latency.list.snapshot().count();
+    auto matches = latency.match.snapshot().count();
+    auto downloads = latency.download.snapshot().count();
+
+    ASSERT_TRUE(download().has_value());
+    EXPECT_EQ(latency.list.snapshot().count(), lists + 1);
+    EXPECT_EQ(latency.match.snapshot().count(), matches + 1);
+    auto recorded = latency.download.snapshot();
+    EXPECT_EQ(recorded.count(), downloads + 1);
+    EXPECT_GT(recorded.max().count(), 0);
+
+    kw::enableFtpLatency(false);
+    ASSERT_TRUE(download().has_value());
+    EXPECT_EQ(latency.download.snapshot().count(), downloads + 1); // off by default, opt-in only
+}
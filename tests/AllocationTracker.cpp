@@ -0,0 +1,169 @@
+#include "AllocationTracker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint> // uintptr_t
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    /** @brief What the whole process or one thread allocated, the latter freed by whichever thread */
+    struct Counters
+    {
+        std::atomic<size_t> allocations {0};
+        std::atomic<size_t> deallocations {0};
+        std::atomic<size_t> bytes {0};
+        std::atomic<ptrdiff_t> live {0};
+        std::atomic<size_t> peak {0};
+        Counters* next = nullptr;
+    };
+
+    // constant-initialized, so it works for allocations before main() as well
+    constinit Counters processCounters;
+    constinit std::atomic<Counters*> allThreadCounters {nullptr};
+
+    /** @brief Sits right before every block, delete needs the size, the allocating thread and malloc's pointer */
+    struct Header
+    {
+        void* raw;
+        size_t size;
+        Counters* owner;
+    };
+
+    constexpr size_t HEADER_SPACE = (sizeof(Header) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+    Counters& threadCounters() noexcept
+    {
+        // never freed, blocks of an exited thread can still be freed later; the list keeps them reachable
+        thread_local Counters* counters = nullptr;
+        if (!counters)
+        {
+            void* p = std::malloc(sizeof(Counters));
+            if (!p) std::abort();
+            counters = new (p) Counters;
+            counters->next = allThreadCounters.load(std::memory_order_relaxed);
+            while (!allThreadCounters.compare_exchange_weak(counters->next, counters, std::memory_order_release, std::memory_order_relaxed)) {}
+        }
+        return *counters;
+    }
+
+    Counters& countersFor(AllocationTracker::Scope scope) noexcept
+    {
+        return scope == AllocationTracker::Scope::Thread ? threadCounters() : processCounters;
+    }
+
+    void raisePeak(Counters& counters, size_t live) noexcept
+    {
+        size_t peak = counters.peak.load(std::memory_order_relaxed);
+        while (live > peak && !counters.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+    }
+
+    void countAllocation(Counters& counters, size_t size) noexcept
+    {
+        counters.allocations.fetch_add(1, std::memory_order_relaxed);
+        counters.bytes.fetch_add(size, std::memory_order_relaxed);
+        ptrdiff_t live = counters.live.fetch_add(static_cast<ptrdiff_t>(size), std::memory_order_relaxed) + static_cast<ptrdiff_t>(size);
+        raisePeak(counters, static_cast<size_t>(std::max<ptrdiff_t>(live, 0)));
+    }
+
+    void countDeallocation(Counters& counters, size_t size) noexcept
+    {
+        counters.deallocations.fetch_add(1, std::memory_order_relaxed);
+        counters.live.fetch_sub(static_cast<ptrdiff_t>(size), std::memory_order_relaxed);
+    }
+
+    void* allocate(size_t size, size_t align) noexcept
+    {
+        size_t extra = align > alignof(std::max_align_t) ? align : 0;
+        void* raw = std::malloc(HEADER_SPACE + extra + size);
+        if (!raw) return nullptr;
+        uintptr_t user = reinterpret_cast<uintptr_t>(raw) + HEADER_SPACE;
+        if (extra) user = (user + align - 1) & ~(uintptr_t(align) - 1);
+
+        Counters& owner = threadCounters();
+        Header* header = reinterpret_cast<Header*>(user) - 1;
+        *header = { raw, size, &owner };
+        countAllocation(processCounters, size);
+        countAllocation(owner, size);
+        return reinterpret_cast<void*>(user);
+    }
+
+    void* allocateOrThrow(size_t size, size_t align)
+    {
+        while (true)
+        {
+            if (void* p = allocate(size, align))
+                return p;
+            std::new_handler handler = std::get_new_handler();
+            if (!handler) throw std::bad_alloc();
+            handler();
+        }
+    }
+
+    void deallocate(void* p) noexcept
+    {
+        if (!p) return;
+        Header* header = static_cast<Header*>(p) - 1;
+        countDeallocation(processCounters, header->size);
+        countDeallocation(*header->owner, header->size);
+        std::free(header->raw);
+    }
+
+    AllocationStats now(const Counters& counters) noexcept
+    {
+        AllocationStats s;
+        s.allocations = counters.allocations.load(std::memory_order_relaxed);
+        s.deallocations = counters.deallocations.load(std::memory_order_relaxed);
+        s.bytes = counters.bytes.load(std::memory_order_relaxed);
+        s.liveBytes = counters.live.load(std::memory_order_relaxed);
+        s.peakBytes = counters.peak.load(std::memory_order_relaxed);
+        return s;
+    }
+}
+
+AllocationTracker::AllocationTracker(Scope scope) noexcept
+: scope {scope}
+, start {now(countersFor(scope))}
+, outerPeak {countersFor(scope).peak.exchange(static_cast<size_t>(std::max<ptrdiff_t>(start.liveBytes, 0)))}
+{}
+
+AllocationTracker::~AllocationTracker()
+{
+    raisePeak(countersFor(scope), outerPeak);
+}
+
+AllocationStats AllocationTracker::stats() const noexcept
+{
+    AllocationStats s = now(countersFor(scope));
+    s.allocations -= start.allocations;
+    s.deallocations -= start.deallocations;
+    s.bytes -= start.bytes;
+    s.peakBytes = static_cast<size_t>(std::max<ptrdiff_t>(static_cast<ptrdiff_t>(s.peakBytes) - start.liveBytes, 0));
+    s.liveBytes -= start.liveBytes;
+    return s;
+}
+
+// every replaceable form, a runtime like ASan may bring its own of those left out
+void* operator new(size_t size) { return allocateOrThrow(size, alignof(std::max_align_t)); }
+void* operator new[](size_t size) { return allocateOrThrow(size, alignof(std::max_align_t)); }
+void* operator new(size_t size, std::align_val_t align) { return allocateOrThrow(size, static_cast<size_t>(align)); }
+void* operator new[](size_t size, std::align_val_t align) { return allocateOrThrow(size, static_cast<size_t>(align)); }
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return allocate(size, alignof(std::max_align_t)); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return allocate(size, alignof(std::max_align_t)); }
+void* operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return allocate(size, static_cast<size_t>(align)); }
+void* operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return allocate(size, static_cast<size_t>(align)); }
+
+void operator delete(void* p) noexcept { deallocate(p); }
+void operator delete[](void* p) noexcept { deallocate(p); }
+void operator delete(void* p, size_t) noexcept { deallocate(p); }
+void operator delete[](void* p, size_t) noexcept { deallocate(p); }
+void operator delete(void* p, std::align_val_t) noexcept { deallocate(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { deallocate(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { deallocate(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { deallocate(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { deallocate(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { deallocate(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { deallocate(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { deallocate(p); }
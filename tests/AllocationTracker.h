@@ -0,0 +1,69 @@
+#pragma once
+#include "gtest/gtest.h"
+
+#include <cstddef> // size_t, ptrdiff_t
+#include <utility>
+
+/** @brief What global operator new/delete did, see AllocationTracker */
+struct AllocationStats
+{
+    size_t allocations = 0;
+    size_t deallocations = 0;
+    size_t bytes = 0;         // requested by the allocations
+    ptrdiff_t liveBytes = 0;  // allocated minus freed, negative if older blocks were freed
+    size_t peakBytes = 0;     // highest live bytes above the start
+};
+
+/**
+ * @brief Counts what global operator new and delete did from construction on.
+ *        The test binary replaces every form of them in AllocationTracker.cpp for it.
+ *        Trackers nest. malloc() and friends are not counted.
+ *
+ * Scope::Thread counts the blocks the constructing thread allocates, and
+ * their frees by whichever thread; what pool workers or other tests'
+ * leftover threads do meanwhile does not show up. Scope::Process counts
+ * every thread, for tests whose workers allocate on their behalf.
+ */
+class AllocationTracker
+{
+public:
+    enum class Scope
+    {
+        Thread,
+        Process,
+    };
+
+private:
+    Scope scope;
+    AllocationStats start;
+    size_t outerPeak;
+
+public:
+    explicit AllocationTracker(Scope scope = Scope::Thread) noexcept;
+    ~AllocationTracker();
+
+    AllocationTracker(const AllocationTracker&) = delete;
+    AllocationTracker& operator=(const AllocationTracker&) = delete;
+
+    /** @returns What happened since the tracker was constructed */
+    AllocationStats stats() const noexcept;
+};
+
+/**
+ * @brief Allocation budget for a hot path on the calling thread, e.g.
+ *        EXPECT_TRUE(allocatesAtMost(0, [&] { ++it; }));
+ */
+template<typename F>
+testing::AssertionResult allocatesAtMost(size_t limit, F&& block)
+{
+    AllocationStats s;
+    {
+        AllocationTracker tracker;
+        std::forward<F>(block)();
+        s = tracker.stats();
+    }
+    if (s.allocations <= limit)
+        return testing::AssertionSuccess();
+    return testing::AssertionFailure() << s.allocations << " allocation(s) of " << s.bytes
+                                       << " byte(s) in total, the budget is " << limit;
+}
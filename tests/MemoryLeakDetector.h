@@ -1,29 +1,37 @@
-// src: https://stackoverflow.com/a/70968385
 #pragma once
+#include "AllocationTracker.h"
 #include "gtest/gtest.h"
-#include <crtdbg.h>
 
-// Class for detecting memory leaks during testing
-class MemoryLeakDetector 
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+// Class for detecting memory leaks during testing: fails the test if the
+// memory allocated by operator new in its scope is not freed when it ends.
+// Counts the constructing thread by default, see AllocationTracker::Scope
+class MemoryLeakDetector
 {
-    _CrtMemState _memState;
+    // a worker may still drop what it handed back, like a promise's shared state after set_value()
+    static constexpr std::chrono::milliseconds SETTLE_TIME {100};
+
+    AllocationTracker tracker;
 public:
-    MemoryLeakDetector()
-    {
-        _CrtMemCheckpoint(&_memState);
-    }
+    explicit MemoryLeakDetector(AllocationTracker::Scope scope = AllocationTracker::Scope::Thread) noexcept
+    : tracker {scope}
+    {}
 
     ~MemoryLeakDetector()
     {
-        _CrtMemState stateNow, stateDiff;
-        _CrtMemCheckpoint(&stateNow);
-        int diffResult = _CrtMemDifference(&stateDiff, &_memState, &stateNow);
-        if (diffResult)
-            reportFailure(stateDiff.lSizes[1]);
+        AllocationStats s = tracker.stats();
+        for (auto deadline = std::chrono::steady_clock::now() + SETTLE_TIME;
+             s.liveBytes > 0 && std::chrono::steady_clock::now() < deadline; s = tracker.stats())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        if (s.liveBytes > 0)
+            reportFailure(static_cast<size_t>(s.liveBytes), s.allocations - std::min(s.allocations, s.deallocations));
     }
 private:
-    static void reportFailure(size_t unfreedBytes)
+    static void reportFailure(size_t unfreedBytes, size_t unfreedBlocks)
     {
-        FAIL() << "Memory leak of " << unfreedBytes << " byte(s) detected.";
+        FAIL() << "Memory leak of " << unfreedBytes << " byte(s) in " << unfreedBlocks << " block(s) detected.";
     }
-};
\ No newline at end of file
+};